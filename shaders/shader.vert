@@ -1,16 +1,21 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+layout(push_constant) uniform PushConstants {
+    mat4 viewProj;
+} pushConstants;
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inOffset;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec2 fragTexCoord;
+
 out gl_PerVertex {
     vec4 gl_Position;
 };
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
-
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
+    gl_Position = pushConstants.viewProj * vec4(vec3(inPosition, 0.0) + inOffset, 1.0);
+    fragTexCoord = inTexCoord;
 }
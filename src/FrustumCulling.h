@@ -0,0 +1,238 @@
+/**
+ * @file    FrustumCulling.h
+ * @ingroup VulkanTest
+ * @brief   CPU frustum culling of instance bounding spheres using SSE/AVX.
+ *
+ * Copyright (c) 2017 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <future>
+#include <chrono>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+
+/// Select the widest SIMD instruction set enabled at compile time (see the USE_AVX CMake option)
+#if defined(__AVX__)
+#include <immintrin.h>
+#define FRUSTUM_CULLING_AVX
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define FRUSTUM_CULLING_SSE
+#endif
+
+/// Six normalized planes (xyz normal pointing inside, w distance) extracted from a view-projection matrix
+struct Frustum {
+    glm::vec4 planes[6]; ///< Left, right, bottom, top, near, far
+
+    /// Extract the planes from a view-projection matrix (Gribb & Hartmann method)
+    explicit Frustum(const glm::mat4& viewProj) {
+        // glm matrices are column major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+        const glm::vec4 row0(viewProj[0][0], viewProj[1][0], viewProj[2][0], viewProj[3][0]);
+        const glm::vec4 row1(viewProj[0][1], viewProj[1][1], viewProj[2][1], viewProj[3][1]);
+        const glm::vec4 row2(viewProj[0][2], viewProj[1][2], viewProj[2][2], viewProj[3][2]);
+        const glm::vec4 row3(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+
+        planes[0] = row3 + row0;
+        planes[1] = row3 - row0;
+        planes[2] = row3 + row1;
+        planes[3] = row3 - row1;
+        // OpenGL [-1,1] depth convention: conservative for the [0,1] Vulkan depth range
+        planes[4] = row3 + row2;
+        planes[5] = row3 - row2;
+
+        for (auto& plane : planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+    }
+};
+
+/// Statistics of one culling pass
+struct CullingStats {
+    size_t instanceCount    = 0;    ///< Number of instances tested
+    size_t visibleCount     = 0;    ///< Number of instances intersecting the frustum
+    size_t culledCount      = 0;    ///< Number of instances rejected
+    double milliseconds     = 0.0;  ///< Duration of the culling pass
+};
+
+/**
+ * Frustum culling of instance bounding spheres stored as Structure of Arrays
+ *
+ * Spheres are tested 8 at a time with AVX, 4 at a time with SSE (or one by one as a fallback),
+ * with large batches split in chunks processed in parallel by the worker threads of a pool.
+ */
+class FrustumCuller {
+public:
+    /// Arrays are padded to a multiple of this count of spheres, whatever the SIMD width
+    static const size_t PADDING = 8;
+    /// Minimum number of spheres processed by a job, to amortize the cost of the thread synchronization
+    static const size_t MIN_CHUNK_SIZE = 4096;
+
+    /// The pool is used to run the culling in parallel
+    explicit FrustumCuller(ThreadPool& pool) : workerPool(pool) {
+    }
+
+    /// Remove all instances
+    void clear() {
+        centerX.clear();
+        centerY.clear();
+        centerZ.clear();
+        radius.clear();
+        instanceCount = 0;
+    }
+
+    /// Number of instances
+    size_t size() const {
+        return instanceCount;
+    }
+
+    /// Add the bounding sphere of a new instance, returning its index
+    uint32_t addInstance(const glm::vec3& center, float sphereRadius) {
+        const size_t index = instanceCount++;
+        if (index == centerX.size()) {
+            // Padding spheres are always culled: they have a negative infinite radius
+            const size_t paddedCount = centerX.size() + PADDING;
+            centerX.resize(paddedCount, 0.0f);
+            centerY.resize(paddedCount, 0.0f);
+            centerZ.resize(paddedCount, 0.0f);
+            radius.resize(paddedCount, -std::numeric_limits<float>::max());
+        }
+        setInstance(static_cast<uint32_t>(index), center, sphereRadius);
+        return static_cast<uint32_t>(index);
+    }
+
+    /// Update the bounding sphere of an existing instance
+    void setInstance(uint32_t index, const glm::vec3& center, float sphereRadius) {
+        centerX[index] = center.x;
+        centerY[index] = center.y;
+        centerZ[index] = center.z;
+        radius[index] = sphereRadius;
+    }
+
+    /// Compact indices of instances intersecting the frustum into the visible list (in increasing order)
+    CullingStats cull(const glm::mat4& viewProj, std::vector<uint32_t>& visible) {
+        const auto start = std::chrono::high_resolution_clock::now();
+        const Frustum frustum(viewProj);
+        const size_t paddedCount = centerX.size();
+
+        // Split in chunks (multiple of the padding) so that each worker thread gets at least one
+        const size_t jobCount = std::max<size_t>(1, std::min(workerPool.size(), paddedCount / MIN_CHUNK_SIZE));
+        const size_t chunkSize = ((paddedCount / jobCount + PADDING - 1) / PADDING) * PADDING;
+
+        // Each chunk writes its visible indices at the beginning of its own range of the scratch buffer
+        scratch.resize(paddedCount);
+        std::vector<std::future<size_t>> results;
+        for (size_t begin = chunkSize; begin < paddedCount; begin += chunkSize) {
+            const size_t end = std::min(begin + chunkSize, paddedCount);
+            results.push_back(workerPool.enqueue([this, &frustum, begin, end] {
+                return cullRange(frustum, begin, end, scratch.data() + begin);
+            }));
+        }
+        // The calling thread processes the first chunk itself
+        const size_t firstCount = cullRange(frustum, 0, std::min(chunkSize, paddedCount), scratch.data());
+
+        visible.assign(scratch.begin(), scratch.begin() + firstCount);
+        size_t begin = chunkSize;
+        for (auto& result : results) {
+            const size_t count = result.get();
+            visible.insert(visible.end(), scratch.begin() + begin, scratch.begin() + begin + count);
+            begin += chunkSize;
+        }
+
+        const auto end = std::chrono::high_resolution_clock::now();
+
+        CullingStats stats;
+        stats.instanceCount = instanceCount;
+        stats.visibleCount = visible.size();
+        stats.culledCount = instanceCount - visible.size();
+        stats.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+        return stats;
+    }
+
+private:
+    /// Test spheres [begin, end) against the frustum, writing indices of visible ones to the output, returning their count
+    size_t cullRange(const Frustum& frustum, size_t begin, size_t end, uint32_t* output) const {
+        size_t count = 0;
+#if defined(FRUSTUM_CULLING_AVX)
+        __m256 planes[6][4];
+        for (size_t p = 0; p < 6; p++) {
+            for (int c = 0; c < 4; c++) {
+                planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+            }
+        }
+        for (size_t i = begin; i < end; i += 8) {
+            const __m256 x = _mm256_loadu_ps(&centerX[i]);
+            const __m256 y = _mm256_loadu_ps(&centerY[i]);
+            const __m256 z = _mm256_loadu_ps(&centerZ[i]);
+            const __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(&radius[i]));
+            __m256 inside = _mm256_cmp_ps(x, x, _CMP_EQ_OQ); // all bits set (coordinates are never NaN)
+            for (size_t p = 0; p < 6; p++) {
+                const __m256 distance = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(planes[p][0], x), _mm256_mul_ps(planes[p][1], y)),
+                    _mm256_add_ps(_mm256_mul_ps(planes[p][2], z), planes[p][3]));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GE_OQ));
+            }
+            count = compact(_mm256_movemask_ps(inside), 8, i, output, count);
+        }
+#elif defined(FRUSTUM_CULLING_SSE)
+        __m128 planes[6][4];
+        for (size_t p = 0; p < 6; p++) {
+            for (int c = 0; c < 4; c++) {
+                planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+            }
+        }
+        for (size_t i = begin; i < end; i += 4) {
+            const __m128 x = _mm_loadu_ps(&centerX[i]);
+            const __m128 y = _mm_loadu_ps(&centerY[i]);
+            const __m128 z = _mm_loadu_ps(&centerZ[i]);
+            const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius[i]));
+            __m128 inside = _mm_cmpeq_ps(x, x); // all bits set (coordinates are never NaN)
+            for (size_t p = 0; p < 6; p++) {
+                const __m128 distance = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+                    _mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+            }
+            count = compact(_mm_movemask_ps(inside), 4, i, output, count);
+        }
+#else
+        for (size_t i = begin; i < end; i++) {
+            int inside = 1;
+            for (size_t p = 0; p < 6; p++) {
+                const glm::vec4& plane = frustum.planes[p];
+                const float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+                inside &= (distance >= -radius[i]) ? 1 : 0;
+            }
+            count = compact(inside, 1, i, output, count);
+        }
+#endif
+        return count;
+    }
+
+    /// Branchless append of the indices of the set bits of the mask (output must have room for all the lanes)
+    static size_t compact(int mask, int lanes, size_t index, uint32_t* output, size_t count) {
+        for (int lane = 0; lane < lanes; lane++) {
+            output[count] = static_cast<uint32_t>(index + lane);
+            count += (mask >> lane) & 1;
+        }
+        return count;
+    }
+
+private:
+    ThreadPool&             workerPool;         ///< Worker threads running the culling jobs
+    std::vector<float>      centerX;            ///< X coordinates of the centers of the bounding spheres
+    std::vector<float>      centerY;            ///< Y coordinates of the centers of the bounding spheres
+    std::vector<float>      centerZ;            ///< Z coordinates of the centers of the bounding spheres
+    std::vector<float>      radius;             ///< Radius of the bounding spheres
+    size_t                  instanceCount = 0;  ///< Number of instances (arrays are padded beyond that)
+    std::vector<uint32_t>   scratch;            ///< Per chunk visible indices, before compaction
+};
@@ -0,0 +1,604 @@
+/**
+ * @file    HeadlessRenderContext.h
+ * @ingroup VulkanTest
+ * @brief   Offscreen rendering context with its own logical device, sharing the Vulkan instance.
+ *
+ * Copyright (c) 2017 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include "VulkanLayers.h"
+#include "VulkanMemory.h"
+#include "VulkanCapture.h"
+#include "IndirectDrawBatcher.h"
+#include "TextureStreamer.h"
+#include "TestScene.h"
+
+#include <vulkan/vulkan.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <cstdint>
+
+/// Physical device and its query results, shared by all the headless render contexts
+struct PhysicalDeviceInfo {
+    VkPhysicalDevice                    device          = VK_NULL_HANDLE;   ///< Physical Device (GPU)
+    VkPhysicalDeviceProperties          properties      = {};               ///< Name, type, limits...
+    VkPhysicalDeviceMemoryProperties    memoryProperties = {};              ///< Memory types and heaps
+    VkPhysicalDeviceFeatures            features        = {};               ///< Supported features
+    int                                 graphicsFamily  = -1;               ///< Index of the graphic queue family
+
+    /// Create the Vulkan instance without any window system extension (and without validation layers if not available)
+    static VkInstance createInstance(const char* applicationName) {
+        const bool useValidationLayers = enableValidationLayers && checkValidationLayerSupport();
+        if (enableValidationLayers && !useValidationLayers) {
+            std::cerr << "[init] Validation layers requested, but not available: running without them" << std::endl;
+        }
+
+        VkApplicationInfo appInfo = {};
+        appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+        appInfo.pApplicationName = applicationName;
+        appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
+        appInfo.pEngineName = "No Engine";
+        appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
+        appInfo.apiVersion = VK_API_VERSION_1_0;
+
+        VkInstanceCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+        createInfo.pApplicationInfo = &appInfo;
+        if (useValidationLayers) {
+            createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
+            createInfo.ppEnabledLayerNames = validationLayers.data();
+        } else {
+            createInfo.enabledLayerCount = 0;
+        }
+
+        VkInstance instance = VK_NULL_HANDLE;
+        if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+            throw std::runtime_error("Cannot create the Vulkan instance");
+        }
+        return instance;
+    }
+
+    /// Query once the first GPU with a graphics queue family (no presentation support needed)
+    static PhysicalDeviceInfo pick(VkInstance instance) {
+        uint32_t deviceCount = 0;
+        vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
+        if (deviceCount == 0) {
+            throw std::runtime_error("failed to find GPUs with Vulkan support!");
+        }
+        std::vector<VkPhysicalDevice> devices(deviceCount);
+        vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+
+        for (const auto& dev : devices) {
+            uint32_t queueFamilyCount = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(dev, &queueFamilyCount, nullptr);
+            std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+            vkGetPhysicalDeviceQueueFamilyProperties(dev, &queueFamilyCount, queueFamilies.data());
+
+            for (uint32_t i = 0; i < queueFamilyCount; i++) {
+                if (queueFamilies[i].queueCount > 0 && (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+                    PhysicalDeviceInfo info;
+                    info.device = dev;
+                    info.graphicsFamily = static_cast<int>(i);
+                    vkGetPhysicalDeviceProperties(dev, &info.properties);
+                    vkGetPhysicalDeviceMemoryProperties(dev, &info.memoryProperties);
+                    vkGetPhysicalDeviceFeatures(dev, &info.features);
+                    std::cout << "[init] Headless rendering on " << info.properties.deviceName
+                        << " (type " << info.properties.deviceType << ") queueFamily=" << i << std::endl;
+                    return info;
+                }
+            }
+        }
+        throw std::runtime_error("failed to find a suitable GPU!");
+    }
+};
+
+/**
+ * Offscreen render context, with its own Logical Device, to be used by a single thread
+ *
+ * Each frame draws the instance grid of the test scene, with the indirect draw batcher and the textures of its materials
+ * streamed as in the windowed application, into an offscreen color image then copied to a host visible readback buffer.
+ * Frames are not overlapped: each one is completed before the next one starts.
+ */
+class HeadlessRenderContext {
+public:
+    /// Format of the offscreen color image
+    static const VkFormat COLOR_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+    /// Device memory budget of the streamed textures of a context
+    static const VkDeviceSize TEXTURE_BUDGET = 16 * 1024 * 1024;
+
+    /**
+     * Create the Logical Device, the offscreen image and its readback buffer, and the scene drawn into it
+     *
+     * @param vertCode  SPIR V byte code of the vertex shader of the scene, shared by all the contexts
+     * @param fragCode  SPIR V byte code of the fragment shader of the scene, shared by all the contexts
+     */
+    void init(const PhysicalDeviceInfo& info, uint32_t imageWidth, uint32_t imageHeight,
+              const std::vector<char>& vertCode, const std::vector<char>& fragCode) {
+        init(info);
+        width = imageWidth;
+        height = imageHeight;
+
+        createOffscreenImage();
+        createBuffer(info.memoryProperties, device, static_cast<VkDeviceSize>(width) * height * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readbackBuffer, readbackMemory);
+        if (capture) {
+            capture->createBuffer(readbackBuffer, static_cast<VkDeviceSize>(width) * height * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        }
+        createRenderPass();
+        createFramebuffer();
+
+        const uint32_t queueFamily = static_cast<uint32_t>(info.graphicsFamily);
+        textureStreamer.reset(new TextureStreamer);
+        textureStreamer->setCapture(capture);
+        textureStreamer->init(info.device, device, queueFamily, queue, queueFamily, queue, enabledFeatures, TEXTURE_BUDGET);
+        descriptorSetLayout = createMaterialSetLayout(device);
+        createMaterials();
+        pipelineLayout = createScenePipelineLayout(device, descriptorSetLayout);
+        pipeline = createScenePipeline(device, pipelineLayout, renderPass, COLOR_FORMAT, vertCode, fragCode, capture);
+
+        drawBatcher.setCapture(capture);
+        drawBatcher.init(info.device, device, queueFamily, queue, enabledFeatures);
+        createScene();
+        viewProj = sceneViewProj(width / static_cast<float>(height));
+    }
+
+    /// Create the Logical Device with its queue, command buffer and fence, without any offscreen image
+    void init(const PhysicalDeviceInfo& info) {
+        physicalDevice = info;
+
+        const float queuePriority = 1.0f;
+        VkDeviceQueueCreateInfo queueCreateInfo = {};
+        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfo.queueFamilyIndex = static_cast<uint32_t>(info.graphicsFamily);
+        queueCreateInfo.queueCount = 1;
+        queueCreateInfo.pQueuePriorities = &queuePriority;
+
+        // Enable the optional features used by indirect drawing and texture streaming, when supported
+        enabledFeatures = {};
+        enabledFeatures.multiDrawIndirect = info.features.multiDrawIndirect;
+        enabledFeatures.drawIndirectFirstInstance = info.features.drawIndirectFirstInstance;
+        enabledFeatures.textureCompressionBC = info.features.textureCompressionBC;
+
+        VkDeviceCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.queueCreateInfoCount = 1;
+        createInfo.pQueueCreateInfos = &queueCreateInfo;
+        createInfo.pEnabledFeatures = &enabledFeatures;
+        createInfo.enabledExtensionCount = 0;
+        // Device layers are deprecated: the layers enabled on the instance (if available) also apply to the devices
+        createInfo.enabledLayerCount = 0;
+        if (vkCreateDevice(info.device, &createInfo, nullptr, &device) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create logical device!");
+        }
+        vkGetDeviceQueue(device, queueCreateInfo.queueFamilyIndex, 0, &queue);
+
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = queueCreateInfo.queueFamilyIndex;
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create command pool!");
+        }
+
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffer!");
+        }
+
+        // Created signaled, as when no frame is in flight
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create fence!");
+        }
+    }
+
+    /// Record the objects created and the frames rendered from now on (before init to capture the offscreen image)
+    void setCapture(VulkanCapture* vulkanCapture) {
+        capture = vulkanCapture;
+    }
+
+    /// Start recording the command buffer
+    void beginCommands() {
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    }
+
+    /// Submit the command buffer and wait for its completion (leaving the fence signaled)
+    void submitCommands() {
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        vkResetFences(device, 1, &fence);
+        if (vkQueueSubmit(queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit command buffer!");
+        }
+        vkWaitForFences(device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    }
+
+    /// Render a frame of the scene and wait for its completion
+    void renderFrame(uint64_t frameIndex) {
+        if (capture) {
+            capture->beginFrame(frameIndex);
+        }
+        // All the instances are drawn (without culling), so all the materials are visible at full resolution
+        for (const TextureHandle texture : materialTextures) {
+            textureStreamer->touch(texture);
+            textureStreamer->requestLevel(texture, 0);
+        }
+        // The previous frame is completed, so its fence is signaled and the first frame slot is always available
+        drawBatcher.buildCommands(0, sceneInstances, fence);
+        updateMaterialDescriptors();
+        beginCommands();
+
+        // Cycle through clear colors so that each frame differs
+        VkClearValue clearColor = {};
+        clearColor.color.float32[0] = static_cast<float>(frameIndex % 256) / 255.0f;
+        clearColor.color.float32[3] = 1.0f;
+
+        VkRenderPassBeginInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = framebuffer;
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = {width, height};
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearColor;
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        if (capture) {
+            capture->beginRenderPass(image, clearColor.color);
+        }
+
+        VkViewport viewport = {};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(width);
+        viewport.height = static_cast<float>(height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+        VkRect2D scissor = {};
+        scissor.offset = {0, 0};
+        scissor.extent = {width, height};
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &viewProj);
+        if (capture) {
+            capture->pushConstants(VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &viewProj);
+        }
+        drawBatcher.recordDraws(commandBuffer, [this](VkCommandBuffer materialCommandBuffer, uint32_t material) {
+            vkCmdBindDescriptorSets(materialCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+                &descriptorSets[material], 0, nullptr);
+            if (capture) {
+                capture->bindTexture(textureStreamer->getImage(materialTextures[material]));
+            }
+        });
+
+        vkCmdEndRenderPass(commandBuffer);
+        if (capture) {
+            capture->endRenderPass(image);
+        }
+
+        // The render pass leaves the image in the transfer source layout, after the writes of the color attachment
+        VkBufferImageCopy region = {};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { width, height, 1 };
+        vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region);
+        if (capture) {
+            capture->copyImageToBuffer(image, readbackBuffer, 0);
+        }
+
+        submitCommands();
+        textureStreamer->update();
+        if (capture) {
+            capture->endFrame(frameIndex);
+        }
+    }
+
+    /// Destroy all the objects, and the Logical Device
+    void cleanup() {
+        if (device == VK_NULL_HANDLE) {
+            return;
+        }
+        vkDeviceWaitIdle(device);
+        if (textureStreamer) {
+            textureStreamer->cleanup();
+            textureStreamer.reset();
+        }
+        drawBatcher.cleanup();
+        if (pipeline != VK_NULL_HANDLE) {
+            if (capture) {
+                capture->destroyPipeline(pipeline);
+            }
+            vkDestroyPipeline(device, pipeline, nullptr);
+        }
+        if (pipelineLayout != VK_NULL_HANDLE) {
+            vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        }
+        if (descriptorPool != VK_NULL_HANDLE) {
+            vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        }
+        if (descriptorSetLayout != VK_NULL_HANDLE) {
+            vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        }
+        if (framebuffer != VK_NULL_HANDLE) {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+        if (imageView != VK_NULL_HANDLE) {
+            vkDestroyImageView(device, imageView, nullptr);
+        }
+        if (renderPass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(device, renderPass, nullptr);
+        }
+        if (capture) {
+            capture->destroyBuffer(readbackBuffer);
+            capture->destroyImage(image);
+        }
+        destroyBuffer(device, readbackBuffer, readbackMemory);
+        if (image != VK_NULL_HANDLE) {
+            vkDestroyImage(device, image, nullptr);
+            vkFreeMemory(device, imageMemory, nullptr);
+        }
+        if (fence != VK_NULL_HANDLE) {
+            vkDestroyFence(device, fence, nullptr);
+        }
+        if (commandPool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(device, commandPool, nullptr);
+        }
+        vkDestroyDevice(device, nullptr);
+        device = VK_NULL_HANDLE;
+    }
+
+    /// Logical Device of the context
+    VkDevice getDevice() const {
+        return device;
+    }
+
+    /// Queue of the context
+    VkQueue getQueue() const {
+        return queue;
+    }
+
+    /// Command buffer recorded between beginCommands() and submitCommands()
+    VkCommandBuffer getCommandBuffer() const {
+        return commandBuffer;
+    }
+
+    /// Physical Device of the context
+    const PhysicalDeviceInfo& getPhysicalDevice() const {
+        return physicalDevice;
+    }
+
+    /// Optional features enabled on the Logical Device
+    const VkPhysicalDeviceFeatures& getEnabledFeatures() const {
+        return enabledFeatures;
+    }
+
+private:
+    /// Create the offscreen color image
+    void createOffscreenImage() {
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = { width, height, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = COLOR_FORMAT;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create offscreen image!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, image, &memRequirements);
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(physicalDevice.memoryProperties, memRequirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate offscreen image memory!");
+        }
+        vkBindImageMemory(device, image, imageMemory, 0);
+        if (capture) {
+            capture->createImage(image, imageInfo.format, width, height, 1, imageInfo.usage);
+        }
+    }
+
+    /// Create the render pass clearing the offscreen image, leaving it in the layout of its copy to the readback buffer
+    void createRenderPass() {
+        VkAttachmentDescription colorAttachment = {};
+        colorAttachment.format = COLOR_FORMAT;
+        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+        VkAttachmentReference colorAttachmentRef = {};
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorAttachmentRef;
+
+        // Clear the image after the copy of the previous frame, and copy it after the draws of this frame
+        VkSubpassDependency dependencies[2] = {};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dependencies[0].srcAccessMask = 0;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        VkRenderPassCreateInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &colorAttachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 2;
+        renderPassInfo.pDependencies = dependencies;
+
+        if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render pass!");
+        }
+    }
+
+    /// Create the view of the offscreen image and the framebuffer of the render pass using it
+    void createFramebuffer() {
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = COLOR_FORMAT;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create offscreen image view!");
+        }
+
+        VkFramebufferCreateInfo framebufferInfo = {};
+        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        framebufferInfo.renderPass = renderPass;
+        framebufferInfo.attachmentCount = 1;
+        framebufferInfo.pAttachments = &imageView;
+        framebufferInfo.width = width;
+        framebufferInfo.height = height;
+        framebufferInfo.layers = 1;
+        if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create offscreen framebuffer!");
+        }
+    }
+
+    /// Stream the texture of each material, and allocate its descriptor set (written by the frames)
+    void createMaterials() {
+        const uint32_t setCount = static_cast<uint32_t>(MATERIAL_TEXTURES.size());
+
+        VkDescriptorPoolSize poolSize = {};
+        poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSize.descriptorCount = setCount;
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = setCount;
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+
+        const std::vector<VkDescriptorSetLayout> layouts(setCount, descriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = setCount;
+        allocInfo.pSetLayouts = layouts.data();
+        descriptorSets.resize(setCount);
+        if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor sets!");
+        }
+        descriptorViews.assign(setCount, VK_NULL_HANDLE);
+
+        for (const auto& filename : MATERIAL_TEXTURES) {
+            materialTextures.push_back(textureStreamer->load(filename));
+        }
+    }
+
+    /// Register the triangle mesh and the grid of its instances to the draw batcher
+    void createScene() {
+        const std::vector<Vertex> vertices = sceneTriangle();
+        const uint32_t triangle = drawBatcher.addMesh(vertices.data(), sizeof(Vertex), static_cast<uint32_t>(vertices.size()), {0, 1, 2});
+        for (uint32_t y = 0; y < SCENE_GRID_SIZE; y++) {
+            for (uint32_t x = 0; x < SCENE_GRID_SIZE; x++) {
+                InstanceData instance;
+                instance.offset = sceneInstanceOffset(x, y);
+                sceneInstances.push_back(drawBatcher.addInstance(triangle, pipeline, sceneInstanceMaterial(x, y),
+                    &instance, sizeof(InstanceData)));
+            }
+        }
+    }
+
+    /// Point the descriptor sets of the materials to the best image views of their textures (no frame is in flight)
+    void updateMaterialDescriptors() {
+        for (size_t material = 0; material < materialTextures.size(); material++) {
+            const VkImageView view = textureStreamer->getImageView(materialTextures[material]);
+            if (descriptorViews[material] != view) {
+                descriptorViews[material] = view;
+                writeMaterialDescriptor(device, descriptorSets[material], view, textureStreamer->getSampler());
+            }
+        }
+    }
+
+private:
+    PhysicalDeviceInfo  physicalDevice;                     ///< Shared query results of the Physical Device
+    uint32_t            width           = 0;                ///< Width of the offscreen image
+    uint32_t            height          = 0;                ///< Height of the offscreen image
+    VkDevice            device          = VK_NULL_HANDLE;   ///< Logical Device of this context
+    VkQueue             queue           = VK_NULL_HANDLE;   ///< Graphics queue
+    VkCommandPool       commandPool     = VK_NULL_HANDLE;   ///< Pool of the command buffer
+    VkCommandBuffer     commandBuffer   = VK_NULL_HANDLE;   ///< Command buffer re-recorded each frame
+    VkFence             fence           = VK_NULL_HANDLE;   ///< Signaled at the end of a frame
+    VkPhysicalDeviceFeatures enabledFeatures = {};          ///< Optional features enabled on the Logical Device
+    VkImage             image           = VK_NULL_HANDLE;   ///< Offscreen color image
+    VkDeviceMemory      imageMemory     = VK_NULL_HANDLE;   ///< Memory of the offscreen image
+    VkImageView         imageView       = VK_NULL_HANDLE;   ///< View of the offscreen image, attached to the framebuffer
+    VkBuffer            readbackBuffer  = VK_NULL_HANDLE;   ///< Host visible copy of the rendered image
+    VkDeviceMemory      readbackMemory  = VK_NULL_HANDLE;   ///< Memory of the readback buffer
+    VkRenderPass        renderPass      = VK_NULL_HANDLE;   ///< Render pass drawing into the offscreen image
+    VkFramebuffer       framebuffer     = VK_NULL_HANDLE;   ///< Framebuffer of the offscreen image
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE; ///< Texture of a material
+    VkPipelineLayout    pipelineLayout  = VK_NULL_HANDLE;   ///< Material descriptor set and push constants of the pipeline
+    VkPipeline          pipeline        = VK_NULL_HANDLE;   ///< Graphics pipeline of the scene
+    VkDescriptorPool    descriptorPool  = VK_NULL_HANDLE;   ///< Pool of the descriptor sets of the materials
+    std::vector<VkDescriptorSet> descriptorSets;            ///< Descriptor set of each material
+    std::vector<VkImageView> descriptorViews;               ///< Image view written to each descriptor set
+    std::vector<TextureHandle> materialTextures;            ///< Streamed texture of each material
+    std::unique_ptr<TextureStreamer> textureStreamer;       ///< Textures of the materials (with their loader threads, if any scene)
+    IndirectDrawBatcher drawBatcher;                        ///< Megabuffers and indirect draws of the instances
+    std::vector<uint32_t> sceneInstances;                   ///< Instances of the scene, all drawn each frame
+    glm::mat4           viewProj;                           ///< View projection of the scene, for the aspect ratio of the image
+    VulkanCapture*      capture         = nullptr;          ///< Optional capture of the rendered frames
+};
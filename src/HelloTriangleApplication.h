@@ -13,30 +13,33 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include "VulkanLayers.h"
+#include "ThreadPool.h"
+#include "TaskGraph.h"
+#include "FrustumCulling.h"
+#include "IndirectDrawBatcher.h"
+#include "TextureStreamer.h"
+#include "ShaderReloader.h"
+#include "VulkanCapture.h"
+#include "TestScene.h"
+
 #include <iostream>
 #include <stdexcept>
 #include <vector>
 #include <set>
 #include <cstring>
 #include <string>
-#include <fstream>
 #include <limits>
 #include <algorithm>
+#include <chrono>
 
 const int WIDTH = 800;  ///< Width of our window
 const int HEIGHT = 600; ///< Height of our window
 
-/// Enable Validation Layers only on Debug build
-#ifdef NDEBUG
-const bool enableValidationLayers = false;
-#else
-const bool enableValidationLayers = true;
-#endif
+const VkDeviceSize TEXTURE_MEMORY_BUDGET = 256 * 1024 * 1024; ///< Device memory budget of the streamed textures
 
-/// Names of validation layers that we would like to enable in Debug mode
-const std::vector<const char*> validationLayers = {
-    "VK_LAYER_LUNARG_standard_validation"
-};
+/// Frames before destroying a pipeline replaced by a reloaded one: the frames in flight that may still use it, plus one
+const uint64_t PIPELINE_RETIRE_DELAY = IndirectDrawBatcher::FRAME_COUNT + 1;
 
 /// Names of extensions that we need to enable
 const std::vector<const char*> deviceExtensions = {
@@ -73,22 +76,75 @@ void DestroyDebugReportCallbackEXT(
  */
 class HelloTriangleApplication {
 public:
+    /// Record the buffers, textures, pipelines and frames (with their draws) of the next run into a binary trace file
+    void setCaptureFile(const std::string& filename) {
+        captureFilename = filename;
+    }
+
     /// Init and run the application
     void run() {
-        initWindow();
-        initVulkan();
+        startTime = std::chrono::steady_clock::now();
+        if (!captureFilename.empty()) {
+            capture.open(captureFilename);
+            drawBatcher.setCapture(&capture);
+            textureStreamer.setCapture(&capture);
+            shaderReloader.setCapture(&capture);
+        }
+        init();
         mainLoop();
         cleanup();
     }
 
 private:
-    /// Initialize the window of the application
-    void initWindow() {
+    /**
+     * Initialize the window and the Vulkan renderer, overlapping independent steps on the worker threads
+     *
+     * - the window is created on the main thread (as required by GLFW) while the Vulkan instance is created
+     *   and the physical devices are enumerated,
+     * - the SPIR-V shaders are loaded and validated while the device is picked and the Logical Device created,
+     * - the pipeline is compiled (against a render pass depending only on the surface format) while the swapchain
+     *   and its image views are created,
+     * - the meshes and instances of the scene are registered as soon as the pipeline is compiled,
+     *   and the textures of the materials are registered to the streamer as soon as it is ready.
+     */
+    void init() {
+        TaskGraph graph;
+        const auto glfw = graph.add("initGlfw", [this] { initGlfw(); }, {}, true);
+        const auto win = graph.add("initWindow", [this] { initWindow(); }, {glfw}, true);
+        const auto inst = graph.add("createInstance", [this] { createInstance(); setupDebugCallback(); }, {glfw});
+        const auto devices = graph.add("enumeratePhysicalDevices", [this] { enumeratePhysicalDevices(); }, {inst});
+        const auto shaders = graph.add("loadShaders", [this] { loadShaders(); });
+        const auto surf = graph.add("createSurface", [this] { createSurface(); }, {inst, win});
+        const auto pick = graph.add("pickPhysicalDevice", [this] { pickPhysicalDevice(); }, {devices, surf});
+        const auto dev = graph.add("createLogicalDevice", [this] { createLogicalDevice(); }, {pick});
+        const auto batcher = graph.add("initDrawBatcher", [this] { initDrawBatcher(); }, {dev});
+        const auto streamer = graph.add("initTextureStreamer", [this] { initTextureStreamer(); }, {dev});
+        const auto format = graph.add("chooseSurfaceFormat", [this] { chooseSurfaceFormat(); }, {pick});
+        const auto chain = graph.add("createSwapChain", [this] { createSwapChain(); }, {dev, format});
+        const auto views = graph.add("createImageViews", [this] { createImageViews(); }, {chain});
+        const auto pipeline = graph.add("createGraphicsPipeline",
+            [this] { createRenderPass(); createGraphicsPipeline(); }, {dev, format, shaders});
+        graph.add("createFramebuffers", [this] { createFramebuffers(); }, {views, pipeline});
+        graph.add("createCommandBuffers", [this] { createCommandBuffers(); createSyncObjects(); }, {chain});
+        graph.add("createMaterials", [this] { createMaterials(); }, {streamer, pipeline});
+        graph.add("createScene", [this] { createScene(); }, {batcher, pipeline});
+
+        graph.run(workerPool);
+        graph.report("[init]");
+
+        startShaderReload();
+    }
+
+    /// Initialize the GLFW library
+    void initGlfw() {
         glfwInit();
 
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
         glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    }
 
+    /// Initialize the window of the application
+    void initWindow() {
         std::cout << "[init] Create a " << WIDTH << " x " << HEIGHT << " window\n";
         window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
         if (!window) {
@@ -96,18 +152,6 @@ private:
         }
     }
 
-    /// Initialize the Vulkan renderer
-    void initVulkan() {
-        createInstance();
-        setupDebugCallback();
-        createSurface();
-        pickPhysicalDevice();
-        createLogicalDevice();
-        createSwapChain();
-        createImageViews();
-        createGraphicsPipeline();
-    }
-
     /// Create a Vulkan instance
     void createInstance() {
         if (enableValidationLayers && !checkValidationLayerSupport()) {
@@ -155,38 +199,6 @@ private:
         }
     }
 
-    /// Check if our Vulkan SDK provides the validation layers we would like to use
-    // cppcheck-suppress
-    bool checkValidationLayerSupport() {
-        bool allLayersFound = true;
-        uint32_t layerCount;
-        vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
-        std::vector<VkLayerProperties> availableLayers(layerCount);
-        vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
-        std::cout << "[init] There are " << layerCount << " available validation layers:\n";
-        for (const auto& layer : availableLayers) {
-            std::cout << "\t" << layer.layerName << std::endl;
-        }
-
-        for (const char* layerName : validationLayers) {
-            bool layerFound = false;
-
-            for (const auto& layer : availableLayers) {
-                if (strcmp(layerName, layer.layerName) == 0) {
-                    layerFound = true;
-                    break;
-                }
-            }
-
-            if (!layerFound) {
-                std::cerr << "[init] Missing validation layer " << layerName << std::endl;
-                allLayersFound = false;
-            }
-        }
-
-        return allLayersFound;
-    }
-
     /// List required Vulkan extensions
     std::vector<const char*> getRequiredExtensions() {
         std::vector<const char*> extensions;
@@ -258,8 +270,8 @@ private:
         }
     }
 
-    /// Select the first GPU that meets the requirements
-    void pickPhysicalDevice() {
+    /// List the GPUs with Vulkan support (independent of the window surface)
+    void enumeratePhysicalDevices() {
         uint32_t deviceCount = 0;
         vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
 
@@ -267,11 +279,14 @@ private:
             throw std::runtime_error("failed to find GPUs with Vulkan support!");
         }
 
-        std::vector<VkPhysicalDevice> devices(deviceCount);
-        vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
+        physicalDevices.resize(deviceCount);
+        vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data());
+    }
 
-        std::cout << "[init] There are " << deviceCount << " available physical device(s):\n";
-        for (const auto& dev : devices) {
+    /// Select the first GPU that meets the requirements
+    void pickPhysicalDevice() {
+        std::cout << "[init] There are " << physicalDevices.size() << " available physical device(s):\n";
+        for (const auto& dev : physicalDevices) {
             if (isDeviceSuitable(dev)) {
                 physicalDevice = dev;
                 break;
@@ -312,6 +327,7 @@ private:
     struct QueueFamilyIndices {
         int graphicsFamily  = -1;   ///< Index of the graphic queue family (to render images)
         int presentFamily   = -1;   ///< Index of the prensentation queue family (to present rendered images)
+        int transferFamily  = -1;   ///< Index of the transfer queue family (to upload textures), dedicated if available
 
         /// Check if the device has all required queue families
         bool isComplete() const {
@@ -333,23 +349,33 @@ private:
             std::cout << "\t - queueFamily idx " << i
                 << " queueCount=" << queueFamily.queueCount
                 << " flags=0x" << std::hex << queueFamily.queueFlags << std::dec << std::endl;
-            if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-                indices.graphicsFamily = i;
-            }
+            // Keep the first families completing the graphics and presentation requirements
+            if (!indices.isComplete()) {
+                if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+                    indices.graphicsFamily = i;
+                }
 
-            VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(dev, i, surface, &presentSupport);
-            if (queueFamily.queueCount > 0 && presentSupport) {
-                indices.presentFamily = i;
+                VkBool32 presentSupport = false;
+                vkGetPhysicalDeviceSurfaceSupportKHR(dev, i, surface, &presentSupport);
+                if (queueFamily.queueCount > 0 && presentSupport) {
+                    indices.presentFamily = i;
+                }
             }
 
-            if (indices.isComplete()) {
-                break;
+            // Prefer a queue family dedicated to transfers (DMA engine) to upload textures in parallel to rendering
+            if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && indices.transferFamily < 0) {
+                indices.transferFamily = i;
             }
 
             i++;
         }
 
+        // Graphics queues support transfers
+        if (indices.transferFamily < 0) {
+            indices.transferFamily = indices.graphicsFamily;
+        }
+
         return indices;
     }
 
@@ -416,10 +442,12 @@ private:
     void createLogicalDevice() {
         std::cout << "[init] Create a Logical Device with Queues\n";
 
-        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        // Stored for the startup tasks running concurrently, so that they never query the surface used by the swapchain
+        queueFamilies = findQueueFamilies(physicalDevice);
+        const QueueFamilyIndices& indices = queueFamilies;
 
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set<int> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily };
+        std::set<int> uniqueQueueFamilies = { indices.graphicsFamily, indices.presentFamily, indices.transferFamily };
 
         float queuePriority = 1.0f;
         for (int queueFamily : uniqueQueueFamilies) {
@@ -432,13 +460,23 @@ private:
             queueCreateInfos.push_back(queueCreateInfo);
         }
 
-        VkPhysicalDeviceFeatures deviceFeatures = {};
+        // Enable the optional features used by indirect drawing and texture streaming, when supported
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+        enabledFeatures = {};
+        enabledFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+        enabledFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+        enabledFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+        std::cout << "[init] Features multiDrawIndirect=" << enabledFeatures.multiDrawIndirect
+            << " drawIndirectFirstInstance=" << enabledFeatures.drawIndirectFirstInstance
+            << " textureCompressionBC=" << enabledFeatures.textureCompressionBC << std::endl;
+
         VkDeviceCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
         createInfo.queueCreateInfoCount = queueCreateInfos.size();
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-        createInfo.pEnabledFeatures = &deviceFeatures;
+        createInfo.pEnabledFeatures = &enabledFeatures;
         createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
         createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
@@ -455,13 +493,97 @@ private:
 
         vkGetDeviceQueue(device, indices.graphicsFamily, 0, &graphicsQueue);
         vkGetDeviceQueue(device, indices.presentFamily,  0, &presentQueue);
+        vkGetDeviceQueue(device, indices.transferFamily, 0, &transferQueue);
+    }
+
+    /// Prepare indirect drawing with the features enabled on the Logical Device, uploading meshes on the graphics queue
+    void initDrawBatcher() {
+        drawBatcher.init(physicalDevice, device, queueFamilies.graphicsFamily, graphicsQueue, enabledFeatures);
+    }
+
+    /// Prepare texture streaming on the graphics and transfer queues
+    void initTextureStreamer() {
+        textureStreamer.init(physicalDevice, device, queueFamilies.graphicsFamily, graphicsQueue,
+            queueFamilies.transferFamily, transferQueue, enabledFeatures, TEXTURE_MEMORY_BUDGET);
+    }
+
+    /// Stream the texture of each material, and allocate its descriptor set for each frame in flight
+    void createMaterials() {
+        const uint32_t setCount = IndirectDrawBatcher::FRAME_COUNT * static_cast<uint32_t>(MATERIAL_TEXTURES.size());
+
+        VkDescriptorPoolSize poolSize = {};
+        poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSize.descriptorCount = setCount;
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = setCount;
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+
+        const std::vector<VkDescriptorSetLayout> layouts(setCount, descriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = setCount;
+        allocInfo.pSetLayouts = layouts.data();
+
+        descriptorSets.resize(setCount);
+        if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor sets!");
+        }
+        // No image view written yet: written by the first frame using each set
+        descriptorViews.assign(setCount, VK_NULL_HANDLE);
+
+        for (const auto& filename : MATERIAL_TEXTURES) {
+            materialTextures.push_back(textureStreamer.load(filename));
+        }
+    }
+
+    /// Register the meshes and instances drawn by the indirect draw batcher: a test scene of a large grid of triangles,
+    /// centered on the origin, mostly outside of the view frustum
+    void createScene() {
+        const std::vector<Vertex> vertices = sceneTriangle();
+        float radius = 0.0f;
+        for (const auto& vertex : vertices) {
+            radius = std::max(radius, glm::length(vertex.pos));
+        }
+        const uint32_t triangle = drawBatcher.addMesh(vertices.data(), sizeof(Vertex), static_cast<uint32_t>(vertices.size()), {0, 1, 2});
+
+        for (uint32_t y = 0; y < SCENE_GRID_SIZE; y++) {
+            for (uint32_t x = 0; x < SCENE_GRID_SIZE; x++) {
+                InstanceData instance;
+                instance.offset = sceneInstanceOffset(x, y);
+                addInstance(triangle, graphicsPipeline, sceneInstanceMaterial(x, y), instance, radius);
+            }
+        }
+        std::cout << "[init] Scene of " << culler.size() << " instances\n";
+    }
+
+    /// Add an instance of a mesh of the draw batcher, with its bounding sphere (around its offset) for culling
+    uint32_t addInstance(uint32_t mesh, VkPipeline pipeline, uint32_t material, const InstanceData& instance, float radius) {
+        SceneInstance sceneInstance;
+        sceneInstance.offset = instance.offset;
+        sceneInstance.material = material;
+        sceneInstances.push_back(sceneInstance);
+        culler.addInstance(instance.offset, radius);
+        return drawBatcher.addInstance(mesh, pipeline, material, &instance, sizeof(InstanceData));
+    }
+
+    /// Choose the surface format, needed by both the swapchain and the render pass
+    void chooseSurfaceFormat() {
+        surfaceFormat = chooseSwapSurfaceFormat(querySwapChainSupport(physicalDevice).formats);
+        swapChainImageFormat = surfaceFormat.format;
     }
 
     /// Create the swapchain
     void createSwapChain() {
         const SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
-        const VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
         const VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
         swapChainExtent = chooseSwapExtent(swapChainSupport.capabilities);
         std::cout << "[init] SwapExtent " << swapChainExtent.width << "x" << swapChainExtent.height << std::endl;
@@ -483,7 +605,7 @@ private:
         createInfo.imageArrayLayers = 1;
         createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-        QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
+        const QueueFamilyIndices& indices = queueFamilies;
         uint32_t queueFamilyIndices[] = { (uint32_t)indices.graphicsFamily, (uint32_t)indices.presentFamily };
 
         if (indices.graphicsFamily != indices.presentFamily) {
@@ -511,8 +633,9 @@ private:
         vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
         swapChainImages.resize(imageCount);
         vkGetSwapchainImagesKHR(device, swapChain, &imageCount, swapChainImages.data());
-
-        swapChainImageFormat = surfaceFormat.format;
+        for (const VkImage image : swapChainImages) {
+            capture.createImage(image, swapChainImageFormat, swapChainExtent.width, swapChainExtent.height, 1, createInfo.imageUsage);
+        }
     }
 
     /// Select best possible surface format for the swapchain
@@ -598,75 +721,237 @@ private:
         }
     }
 
-    /// Read content of a file (SPIR V binary byte code) into a vector
-    std::vector<char> readFile(const std::string& filename) {
-        std::ifstream file(filename, std::ios::ate | std::ios::binary);
-        if (!file.is_open()) {
-            throw std::runtime_error("failed to open file!");
+    /// Create a framebuffer for each image view of the swapchain
+    void createFramebuffers() {
+        swapChainFramebuffers.resize(swapChainImageViews.size());
+
+        for (size_t i = 0; i < swapChainImageViews.size(); i++) {
+            VkFramebufferCreateInfo framebufferInfo = {};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = renderPass;
+            framebufferInfo.attachmentCount = 1;
+            framebufferInfo.pAttachments = &swapChainImageViews[i];
+            framebufferInfo.width = swapChainExtent.width;
+            framebufferInfo.height = swapChainExtent.height;
+            framebufferInfo.layers = 1;
+
+            if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create framebuffer!");
+            }
         }
+    }
 
-        const size_t fileSize = (size_t) file.tellg();
-        std::vector<char> buffer(fileSize);
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
+    /// Create the command pool and one command buffer per frame in flight, re-recorded each frame
+    void createCommandBuffers() {
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = queueFamilies.graphicsFamily;
+
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create command pool!");
+        }
 
-        return buffer;
-    }   // file closed by RAII design
+        commandBuffers.resize(IndirectDrawBatcher::FRAME_COUNT);
 
-        /// Create a shader module from a binary SPIR V compiled shader
-    VkShaderModule createShaderModule(const std::vector<char>& code) {
-        VkShaderModuleCreateInfo createInfo = {};
-        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
 
-        VkShaderModule shaderModule;
-        if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create shader module!");
+        if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+    }
+
+    /// Create the semaphores and fences synchronizing the frames in flight with the swapchain
+    void createSyncObjects() {
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        // Created signaled, so that the first wait on each frame slot returns immediately
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+        imageAvailableSemaphores.resize(IndirectDrawBatcher::FRAME_COUNT);
+        inFlightFences.resize(IndirectDrawBatcher::FRAME_COUNT);
+        for (size_t i = 0; i < IndirectDrawBatcher::FRAME_COUNT; i++) {
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
+                vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create synchronization objects for a frame!");
+            }
         }
 
-        return shaderModule;
+        // One per swapchain image, since a semaphore waited by the presentation engine can only be reused
+        // once that image is acquired again
+        renderFinishedSemaphores.resize(swapChainImages.size());
+        for (auto& semaphore : renderFinishedSemaphores) {
+            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create synchronization objects for a swapchain image!");
+            }
+        }
+    }
+
+    /// Load and validate the SPIR V binary shaders
+    void loadShaders() {
+        vertShaderCode = loadSpirv("shaders/shader.vert.spv");
+        fragShaderCode = loadSpirv("shaders/shader.frag.spv");
+    }
+
+    /// Create the render pass: one color attachment in the format of the swapchain, cleared then presented
+    void createRenderPass() {
+        VkAttachmentDescription colorAttachment = {};
+        colorAttachment.format = swapChainImageFormat;
+        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+        VkAttachmentReference colorAttachmentRef = {};
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorAttachmentRef;
+
+        // Wait for the swapchain image to be acquired before writing to it
+        VkSubpassDependency dependency = {};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.srcAccessMask = 0;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+        VkRenderPassCreateInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &colorAttachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies = &dependency;
+
+        if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render pass!");
+        }
     }
 
-    /// Create the pipeline
+    /// Create the layouts of the descriptor set of a material and of the pipeline, and the pipeline
     void createGraphicsPipeline() {
-        // Programable stages:
-        const auto vertShaderCode = readFile("shaders/shader.vert.spv");
-        const auto fragShaderCode = readFile("shaders/shader.frag.spv");
-
-        const VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-        const VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-        VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-        vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-        vertShaderStageInfo.module = vertShaderModule;
-        vertShaderStageInfo.pName = "main";
-
-        VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-        fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-        fragShaderStageInfo.module = fragShaderModule;
-        fragShaderStageInfo.pName = "main";
-
-        const VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
-
-        // Static configurable stages:
-        // Vertex Input (no use since we use hard-coded in-shader vertices)
-        VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputInfo.vertexBindingDescriptionCount = 0;
-        vertexInputInfo.pVertexBindingDescriptions = nullptr; // Optional
-        vertexInputInfo.vertexAttributeDescriptionCount = 0;
-        vertexInputInfo.pVertexAttributeDescriptions = nullptr; // Optional
-
-        // We only use the triangle topology for now
-        VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-        inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-        // Viewport
+        descriptorSetLayout = createMaterialSetLayout(device);
+        pipelineLayout = createScenePipelineLayout(device, descriptorSetLayout);
+        graphicsPipeline = buildGraphicsPipeline(vertShaderCode, fragShaderCode);
+    }
+
+    /// Build the pipeline from SPIR V shaders (also called on the shader reloader thread, so only reading members)
+    VkPipeline buildGraphicsPipeline(const std::vector<char>& vertCode, const std::vector<char>& fragCode) {
+        return createScenePipeline(device, pipelineLayout, renderPass, swapChainImageFormat, vertCode, fragCode, &capture);
+    }
+
+    /// Run the application and rendering event loop
+    void mainLoop() {
+        std::cout << "[main] running...\n";
+        while (!glfwWindowShouldClose(window)) {
+            glfwPollEvents();
+            capture.beginFrame(frameNumber);
+            swapReloadedPipelines();
+            cullInstances();
+            requestTextures();
+            drawFrame();
+            currentFrame = (currentFrame + 1) % IndirectDrawBatcher::FRAME_COUNT;
+            textureStreamer.update();
+            capture.endFrame(frameNumber);
+            frameNumber++;
+        }
+        std::cout << "[main] quitting...\n";
+
+        // Wait for the frames in flight before destroying their resources
+        vkDeviceWaitIdle(device);
+    }
+
+    /// Build the draw commands of the visible instances, render them into the next swapchain image and present it
+    void drawFrame() {
+        // Wait for the GPU to be done with this frame slot before re-recording its command buffer
+        // (the draw batcher waits for the same fence before rewriting the indirect buffer of the slot)
+        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+        drawBatcher.buildCommands(currentFrame, visibleInstances, inFlightFences[currentFrame]);
+        updateMaterialDescriptors();
+
+        uint32_t imageIndex = 0;
+        const VkResult acquireResult = vkAcquireNextImageKHR(device, swapChain, std::numeric_limits<uint64_t>::max(),
+            imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        if (acquireResult != VK_SUCCESS && acquireResult != VK_SUBOPTIMAL_KHR) {
+            throw std::runtime_error("failed to acquire swap chain image!");
+        }
+
+        recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+
+        const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &imageAvailableSemaphores[currentFrame];
+        submitInfo.pWaitDstStageMask = &waitStage;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &renderFinishedSemaphores[imageIndex];
+
+        vkResetFences(device, 1, &inFlightFences[currentFrame]);
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
+
+        VkPresentInfoKHR presentInfo = {};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = &renderFinishedSemaphores[imageIndex];
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = &swapChain;
+        presentInfo.pImageIndices = &imageIndex;
+
+        const VkResult presentResult = vkQueuePresentKHR(presentQueue, &presentInfo);
+        if (presentResult != VK_SUCCESS && presentResult != VK_SUBOPTIMAL_KHR) {
+            throw std::runtime_error("failed to present swap chain image!");
+        }
+        if (!firstFrameDone) {
+            firstFrameDone = true;
+            std::cout << "[main] Time to first frame (first present) "
+                << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() << " ms\n";
+        }
+    }
+
+    /// Record the render pass clearing a swapchain image and drawing the visible instances into it
+    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+
+        VkClearValue clearColor = {};
+        clearColor.color.float32[3] = 1.0f;
+
+        VkRenderPassBeginInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = swapChainExtent;
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearColor;
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        capture.beginRenderPass(swapChainImages[imageIndex], clearColor.color);
+
         VkViewport viewport = {};
         viewport.x = 0.0f;
         viewport.y = 0.0f;
@@ -674,69 +959,173 @@ private:
         viewport.height = static_cast<float>(swapChainExtent.height);
         viewport.minDepth = 0.0f;
         viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
         VkRect2D scissor = {};
         scissor.offset = {0, 0};
         scissor.extent = swapChainExtent;
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+        // The same view projection as the one used for culling, shared by all the pipelines (same layout)
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &viewProj);
+        capture.pushConstants(VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &viewProj);
+        drawBatcher.recordDraws(commandBuffer, [this](VkCommandBuffer materialCommandBuffer, uint32_t material) {
+            vkCmdBindDescriptorSets(materialCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+                &descriptorSets[currentFrame * materialTextures.size() + material], 0, nullptr);
+            capture.bindTexture(textureStreamer.getImage(materialTextures[material]));
+        });
+
+        vkCmdEndRenderPass(commandBuffer);
+        capture.endRenderPass(swapChainImages[imageIndex]);
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+    }
 
-        VkPipelineViewportStateCreateInfo viewportState = {};
-        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        viewportState.viewportCount = 1;
-        viewportState.pViewports = &viewport;
-        viewportState.scissorCount = 1;
-        viewportState.pScissors = &scissor;
-
-        VkPipelineRasterizationStateCreateInfo rasterizer = {};
-        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-        rasterizer.depthClampEnable = VK_FALSE;
-        rasterizer.rasterizerDiscardEnable = VK_FALSE;
-        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-        rasterizer.lineWidth = 1.0f;
-        rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-        rasterizer.depthBiasEnable = VK_FALSE;
-        rasterizer.depthBiasConstantFactor = 0.0f; // Optional
-        rasterizer.depthBiasClamp = 0.0f; // Optional
-        rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
-
-        VkPipelineMultisampleStateCreateInfo multisampling = {};
-        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        multisampling.sampleShadingEnable = VK_FALSE;
-        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-        multisampling.minSampleShading = 1.0f; // Optional
-        multisampling.pSampleMask = nullptr; // Optional
-        multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
-        multisampling.alphaToOneEnable = VK_FALSE; // Optional
-
-        VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-        colorBlendAttachment.colorWriteMask =
-            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-        colorBlendAttachment.blendEnable = VK_FALSE;
-        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; // Optional
-        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-
-        vkDestroyShaderModule(device, fragShaderModule, nullptr);
-        vkDestroyShaderModule(device, vertShaderModule, nullptr);
+    /// Development mode: rebuild the graphics pipeline on a background thread when its GLSL shaders are modified
+    void startShaderReload() {
+        graphicsPipelineReload = shaderReloader.addPipeline({"shader.vert", "shader.frag"}, [this] {
+            return buildGraphicsPipeline(loadSpirv("shaders/shader.vert.spv"), loadSpirv("shaders/shader.frag.spv"));
+        });
+#ifdef SHADER_HOT_RELOAD
+        shaderReloader.start(device, SHADERS_SOURCE_DIR, "shaders", GLSLANG_VALIDATOR_PATH);
+#endif
     }
 
-    /// Run the application and rendering event loop
-    void mainLoop() {
-        std::cout << "[main] running...\n";
-        while (!glfwWindowShouldClose(window)) {
-            glfwPollEvents();
+    /// Instance of the scene, as needed to stream the textures of the visible ones
+    struct SceneInstance {
+        glm::vec3   offset;     ///< Position of the instance in world space
+        uint32_t    material;   ///< Material identifier, index in MATERIAL_TEXTURES
+    };
+
+    /// Pipeline replaced by a reloaded one, waiting for the frames in flight using it
+    struct RetiredPipeline {
+        VkPipeline  pipeline;   ///< Replaced pipeline
+        uint64_t    frame;      ///< Frame number when it was replaced
+    };
+
+    /// At a frame boundary, swap in the pipeline rebuilt by the shader reloader (if any), retiring the previous one
+    void swapReloadedPipelines() {
+        const VkPipeline reloaded = shaderReloader.takePipeline(graphicsPipelineReload);
+        if (reloaded != VK_NULL_HANDLE) {
+            drawBatcher.replacePipeline(graphicsPipeline, reloaded);
+            RetiredPipeline retired;
+            retired.pipeline = graphicsPipeline;
+            retired.frame = frameNumber;
+            retiredPipelines.push_back(retired);
+            graphicsPipeline = reloaded;
+            std::cout << "[reload] Swapped the graphics pipeline at frame " << frameNumber << std::endl;
+        }
+
+        // Destroy the retired pipelines once the frames in flight that may use them are completed
+        auto it = retiredPipelines.begin();
+        while (it != retiredPipelines.end()) {
+            if (frameNumber >= it->frame + PIPELINE_RETIRE_DELAY) {
+                capture.destroyPipeline(it->pipeline);
+                vkDestroyPipeline(device, it->pipeline, nullptr);
+                it = retiredPipelines.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    /// Cull instances against the view frustum, compacting the visible ones into the per-frame instance list
+    void cullInstances() {
+        const float aspect = swapChainExtent.width / static_cast<float>(swapChainExtent.height);
+        viewProj = sceneViewProj(aspect);
+        const CullingStats stats = culler.cull(viewProj, visibleInstances);
+        cullingFrameCount++;
+        cullingCulledCount += stats.culledCount;
+        cullingMilliseconds += stats.milliseconds;
+
+        // Report averages once per second
+        const auto now = std::chrono::steady_clock::now();
+        if (now - cullingReportTime >= std::chrono::seconds(1)) {
+            if (stats.instanceCount > 0) {
+                std::cout << "[cull] " << stats.instanceCount << " instances: "
+                    << cullingCulledCount / cullingFrameCount << " culled, "
+                    << cullingMilliseconds / cullingFrameCount << " ms per frame ("
+                    << cullingFrameCount << " frames, " << workerPool.size() << " threads)\n";
+            }
+            cullingFrameCount = 0;
+            cullingCulledCount = 0;
+            cullingMilliseconds = 0.0;
+            cullingReportTime = now;
+        }
+    }
+
+    /// Mark the textures of the visible materials as used, requesting the mip level needed by their nearest instance
+    void requestTextures() {
+        std::vector<float> nearest(materialTextures.size(), std::numeric_limits<float>::max());
+        for (const uint32_t index : visibleInstances) {
+            const SceneInstance& instance = sceneInstances[index];
+            nearest[instance.material] = std::min(nearest[instance.material], glm::length(instance.offset - CAMERA_POSITION));
+        }
+        for (size_t material = 0; material < materialTextures.size(); material++) {
+            if (nearest[material] < std::numeric_limits<float>::max()) {
+                uint32_t level = 0;
+                for (float distance = TEXTURE_FULL_RESOLUTION_DISTANCE; distance < nearest[material]; distance *= 2.0f) {
+                    level++;
+                }
+                textureStreamer.touch(materialTextures[material]);
+                textureStreamer.requestLevel(materialTextures[material], level);
+            }
+        }
+    }
+
+    /// Point the descriptor sets of the current frame slot to the best image views of the textures (the slot is not in use by the GPU)
+    void updateMaterialDescriptors() {
+        for (size_t material = 0; material < materialTextures.size(); material++) {
+            const size_t index = currentFrame * materialTextures.size() + material;
+            const VkImageView view = textureStreamer.getImageView(materialTextures[material]);
+            if (descriptorViews[index] == view) {
+                continue;
+            }
+            descriptorViews[index] = view;
+
+            writeMaterialDescriptor(device, descriptorSets[index], view, textureStreamer.getSampler());
         }
-        std::cout << "[main] quitting...\n";
     }
 
     /// Cleanup all ressources before closing
     void cleanup() {
+        shaderReloader.stop();
+        textureStreamer.cleanup();
+        drawBatcher.cleanup();
+
+        for (auto semaphore : renderFinishedSemaphores) {
+            vkDestroySemaphore(device, semaphore, nullptr);
+        }
+        for (size_t i = 0; i < inFlightFences.size(); i++) {
+            vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+            vkDestroyFence(device, inFlightFences[i], nullptr);
+        }
+        vkDestroyCommandPool(device, commandPool, nullptr);
+
+        for (auto framebuffer : swapChainFramebuffers) {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+
+        for (const auto& retired : retiredPipelines) {
+            capture.destroyPipeline(retired.pipeline);
+            vkDestroyPipeline(device, retired.pipeline, nullptr);
+        }
+        retiredPipelines.clear();
+        capture.destroyPipeline(graphicsPipeline);
+        vkDestroyPipeline(device, graphicsPipeline, nullptr);
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        vkDestroyRenderPass(device, renderPass, nullptr);
+
         for (auto imageView : swapChainImageViews) {
             vkDestroyImageView(device, imageView, nullptr);
         }
 
+        for (const VkImage image : swapChainImages) {
+            capture.destroyImage(image);
+        }
         vkDestroySwapchainKHR(device, swapChain, nullptr);
 
         vkDestroyDevice(device, nullptr);
@@ -751,6 +1140,8 @@ private:
         glfwDestroyWindow(window);
 
         glfwTerminate();
+
+        capture.close();
     }
 
 private:
@@ -758,13 +1149,54 @@ private:
     VkInstance                  instance        = 0;                ///< Vulkan instance
     VkDebugReportCallbackEXT    callback        = 0;                ///< Debug callback
     VkSurfaceKHR                surface         = 0;                ///< Abstract surface to prense the rendered image
+    std::vector<VkPhysicalDevice> physicalDevices;                  ///< GPUs with Vulkan support
     VkPhysicalDevice            physicalDevice  = VK_NULL_HANDLE;   ///< Physical Device (GPU)
+    VkPhysicalDeviceFeatures    enabledFeatures = {};               ///< Optional features enabled on the Logical Device
+    QueueFamilyIndices          queueFamilies;                      ///< Queue families of the Logical Device
     VkDevice                    device          = 0;                ///< Logical Device commands the GPU with Queues
     VkQueue                     graphicsQueue   = 0;                ///< Queue to communicate with the GPU
     VkQueue                     presentQueue    = 0;                ///< Queue to present the rendered image
+    VkQueue                     transferQueue   = 0;                ///< Queue to upload textures
+    VkSurfaceFormatKHR          surfaceFormat   = {};               ///< Pixel format and color space of the swapchain
     VkSwapchainKHR              swapChain       = 0;                ///< The swapchain
     std::vector<VkImage>        swapChainImages;                    ///< Handles to the images of the swapchain
     VkFormat                    swapChainImageFormat = VK_FORMAT_UNDEFINED; ///< Image format
     VkExtent2D                  swapChainExtent = {};               ///< Image dimension
     std::vector<VkImageView>    swapChainImageViews;                ///< Image views of the swapchain
+    std::vector<VkFramebuffer>  swapChainFramebuffers;              ///< Framebuffers of the swapchain image views
+    VkCommandPool               commandPool     = VK_NULL_HANDLE;   ///< Pool of the frame command buffers
+    std::vector<VkCommandBuffer> commandBuffers;                    ///< Command buffer of each frame in flight
+    std::vector<VkSemaphore>    imageAvailableSemaphores;           ///< Swapchain image acquired, per frame in flight
+    std::vector<VkSemaphore>    renderFinishedSemaphores;           ///< Rendering done, per swapchain image to present
+    std::vector<VkFence>        inFlightFences;                     ///< Frame completed by the GPU, per frame in flight
+    std::vector<char>           vertShaderCode;                     ///< SPIR V byte code of the vertex shader
+    std::vector<char>           fragShaderCode;                     ///< SPIR V byte code of the fragment shader
+    VkRenderPass                renderPass      = VK_NULL_HANDLE;   ///< Render pass drawing into the swapchain images
+    VkDescriptorSetLayout       descriptorSetLayout = VK_NULL_HANDLE; ///< Texture of a material
+    VkPipelineLayout            pipelineLayout  = VK_NULL_HANDLE;   ///< Material descriptor set and push constants of the pipeline
+    VkDescriptorPool            descriptorPool  = VK_NULL_HANDLE;   ///< Pool of the descriptor sets of the materials
+    std::vector<VkDescriptorSet> descriptorSets;                    ///< Descriptor set of each material, per frame in flight
+    std::vector<VkImageView>    descriptorViews;                    ///< Image view written to each descriptor set
+    std::vector<TextureHandle>  materialTextures;                   ///< Streamed texture of each material
+    VkPipeline                  graphicsPipeline = VK_NULL_HANDLE;  ///< The graphics pipeline
+    std::chrono::steady_clock::time_point startTime;                ///< Start of the application, to time the first frame
+    bool                        firstFrameDone  = false;            ///< Time to first present already reported
+    uint64_t                    frameNumber     = 0;                ///< Number of frames since the start
+    ShaderReloader              shaderReloader;                     ///< Development mode recompiling modified shaders
+    size_t                      graphicsPipelineReload = 0;         ///< Index of the graphics pipeline in the shader reloader
+    std::vector<RetiredPipeline> retiredPipelines;                  ///< Pipelines waiting for their destruction
+    ThreadPool                  workerPool;                         ///< Worker threads for parallel jobs
+    FrustumCuller               culler{workerPool};                 ///< Bounding spheres of the instances
+    glm::mat4                   viewProj;                           ///< View projection of the frame, for culling and drawing
+    std::vector<SceneInstance>  sceneInstances;                     ///< Position and material of the instances, for texture streaming
+    std::vector<uint32_t>       visibleInstances;                   ///< Per-frame list of instances surviving the culling
+    size_t                      cullingFrameCount   = 0;            ///< Number of frames culled since last report
+    size_t                      cullingCulledCount  = 0;            ///< Number of instances culled since last report
+    double                      cullingMilliseconds = 0.0;          ///< Time spent culling since last report
+    std::chrono::steady_clock::time_point cullingReportTime = std::chrono::steady_clock::now(); ///< Time of last report
+    IndirectDrawBatcher         drawBatcher;                        ///< Indirect draw commands of the visible instances
+    uint32_t                    currentFrame    = 0;                ///< Index of the frame slot being rendered
+    TextureStreamer             textureStreamer;                    ///< Textures streamed under a memory budget
+    std::string                 captureFilename;                    ///< Trace file to record (none by default)
+    VulkanCapture               capture;                            ///< Capture of the buffers, textures, pipelines and frames
 };
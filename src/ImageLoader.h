@@ -0,0 +1,247 @@
+/**
+ * @file    ImageLoader.h
+ * @ingroup VulkanTest
+ * @brief   Decode texture image files (binary PPM and KTX with block-compressed formats) into memory.
+ *
+ * Copyright (c) 2017 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <cstdint>
+
+/// Size and location of a mip level of an image in memory
+struct ImageLevel {
+    uint32_t    width   = 0;    ///< Width in pixels
+    uint32_t    height  = 0;    ///< Height in pixels
+    size_t      offset  = 0;    ///< Offset of the level in the data
+    size_t      size    = 0;    ///< Size of the level in bytes
+};
+
+/// Decoded image: a chain of mip levels (only the first one for uncompressed images, the others are generated on the GPU)
+struct ImageData {
+    VkFormat                    format      = VK_FORMAT_UNDEFINED;  ///< Vulkan format of the texels
+    bool                        compressed  = false;    ///< Block-compressed format (4x4 texel blocks)
+    uint32_t                    texelSize   = 0;        ///< Bytes per texel, or per 4x4 block for compressed formats
+    std::vector<ImageLevel>     levels;                 ///< Mip levels available in memory
+    std::vector<unsigned char>  data;                   ///< Texels of all levels
+
+    /// Width of the image in pixels
+    uint32_t width() const {
+        return levels.empty() ? 0 : levels[0].width;
+    }
+
+    /// Height of the image in pixels
+    uint32_t height() const {
+        return levels.empty() ? 0 : levels[0].height;
+    }
+};
+
+/// Number of levels of a full mip chain down to 1x1
+inline uint32_t mipLevelCount(uint32_t width, uint32_t height) {
+    uint32_t levels = 1;
+    while ((width > 1) || (height > 1)) {
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+        levels++;
+    }
+    return levels;
+}
+
+/// Size in bytes of a level of the given dimensions
+inline size_t levelSize(uint32_t width, uint32_t height, uint32_t texelSize, bool compressed) {
+    if (compressed) {
+        return static_cast<size_t>(std::max(1u, (width + 3) / 4)) * std::max(1u, (height + 3) / 4) * texelSize;
+    }
+    return static_cast<size_t>(width) * height * texelSize;
+}
+
+/// Read a whitespace separated decimal value of a PPM header, skipping comments
+inline uint32_t readPpmValue(std::istream& file) {
+    char c = 0;
+    while (file.get(c)) {
+        if (c == '#') {
+            while (file.get(c) && c != '\n') {}
+        } else if (!isspace(static_cast<unsigned char>(c))) {
+            break;
+        }
+    }
+    uint32_t value = 0;
+    while (file && isdigit(static_cast<unsigned char>(c))) {
+        value = value * 10 + (c - '0');
+        file.get(c);
+    }
+    // The single whitespace after the last header value is consumed by file.get()
+    return value;
+}
+
+/// Decode a binary RGB PPM ("P6") image into RGBA8 texels
+inline ImageData loadPpm(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    char magic[2] = {};
+    if (!file.is_open() || !file.read(magic, 2) || magic[0] != 'P' || magic[1] != '6') {
+        throw std::runtime_error("failed to open PPM image " + filename);
+    }
+    const uint32_t width = readPpmValue(file);
+    const uint32_t height = readPpmValue(file);
+    const uint32_t maxValue = readPpmValue(file);
+    if (width == 0 || height == 0 || maxValue != 255) {
+        throw std::runtime_error("unsupported PPM image " + filename);
+    }
+
+    std::vector<unsigned char> rgb(static_cast<size_t>(width) * height * 3);
+    if (!file.read(reinterpret_cast<char*>(rgb.data()), rgb.size())) {
+        throw std::runtime_error("truncated PPM image " + filename);
+    }
+
+    ImageData image;
+    image.format = VK_FORMAT_R8G8B8A8_UNORM;
+    image.texelSize = 4;
+    image.data.resize(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0, j = 0; i < rgb.size(); i += 3, j += 4) {
+        image.data[j + 0] = rgb[i + 0];
+        image.data[j + 1] = rgb[i + 1];
+        image.data[j + 2] = rgb[i + 2];
+        image.data[j + 3] = 255;
+    }
+    ImageLevel level;
+    level.width = width;
+    level.height = height;
+    level.size = image.data.size();
+    image.levels.push_back(level);
+    return image;
+}
+
+/// Map an OpenGL internal format of a KTX file to a Vulkan format
+inline bool ktxFormat(uint32_t glInternalFormat, ImageData& image) {
+    switch (glInternalFormat) {
+    case 0x8058: // GL_RGBA8
+        image.format = VK_FORMAT_R8G8B8A8_UNORM;
+        image.texelSize = 4;
+        return true;
+    case 0x83F1: // GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+        image.format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        image.texelSize = 8;
+        break;
+    case 0x83F2: // GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+        image.format = VK_FORMAT_BC2_UNORM_BLOCK;
+        image.texelSize = 16;
+        break;
+    case 0x83F3: // GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+        image.format = VK_FORMAT_BC3_UNORM_BLOCK;
+        image.texelSize = 16;
+        break;
+    case 0x8E8C: // GL_COMPRESSED_RGBA_BPTC_UNORM
+        image.format = VK_FORMAT_BC7_UNORM_BLOCK;
+        image.texelSize = 16;
+        break;
+    default:
+        return false;
+    }
+    image.compressed = true;
+    return true;
+}
+
+/// Decode a 2D KTX (version 1) image: block-compressed with all its mip levels, or the first level of an RGBA8 one
+inline ImageData loadKtx(const std::string& filename) {
+    static const unsigned char identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+    struct Header {
+        uint32_t endianness, glType, glTypeSize, glFormat, glInternalFormat, glBaseInternalFormat;
+        uint32_t pixelWidth, pixelHeight, pixelDepth, numberOfArrayElements, numberOfFaces, numberOfMipmapLevels;
+        uint32_t bytesOfKeyValueData;
+    } header;
+
+    std::ifstream file(filename, std::ios::binary);
+    unsigned char magic[12] = {};
+    if (!file.is_open() || !file.read(reinterpret_cast<char*>(magic), sizeof(magic)) || memcmp(magic, identifier, sizeof(magic)) != 0) {
+        throw std::runtime_error("failed to open KTX image " + filename);
+    }
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.endianness != 0x04030201 ||
+        header.pixelDepth > 1 || header.numberOfArrayElements > 0 || header.numberOfFaces != 1) {
+        throw std::runtime_error("unsupported KTX image " + filename);
+    }
+
+    ImageData image;
+    if (!ktxFormat(header.glInternalFormat, image)) {
+        throw std::runtime_error("unsupported KTX format " + filename);
+    }
+    file.seekg(header.bytesOfKeyValueData, std::ios::cur);
+
+    // Uncompressed levels are generated on the GPU, so only the first one is read
+    const uint32_t levelCount = image.compressed ? std::max(1u, header.numberOfMipmapLevels) : 1;
+    uint32_t width = header.pixelWidth;
+    uint32_t height = std::max(1u, header.pixelHeight);
+    for (uint32_t i = 0; i < levelCount; i++) {
+        uint32_t imageSize = 0;
+        if (!file.read(reinterpret_cast<char*>(&imageSize), sizeof(imageSize)) ||
+            imageSize != levelSize(width, height, image.texelSize, image.compressed)) {
+            throw std::runtime_error("invalid KTX level size " + filename);
+        }
+        ImageLevel level;
+        level.width = width;
+        level.height = height;
+        level.offset = image.data.size();
+        level.size = imageSize;
+        image.data.resize(level.offset + level.size);
+        if (!file.read(reinterpret_cast<char*>(&image.data[level.offset]), level.size)) {
+            throw std::runtime_error("truncated KTX image " + filename);
+        }
+        file.seekg((4 - imageSize % 4) % 4, std::ios::cur); // mipPadding
+        image.levels.push_back(level);
+
+        width = std::max(1u, width / 2);
+        height = std::max(1u, height / 2);
+    }
+    return image;
+}
+
+/// Decode an image file, selecting the decoder from the file extension (".ppm" or ".ktx")
+inline ImageData loadImage(const std::string& filename) {
+    const size_t dot = filename.find_last_of('.');
+    const std::string extension = (dot != std::string::npos) ? filename.substr(dot) : std::string();
+    if (extension == ".ktx") {
+        return loadKtx(filename);
+    } else if (extension == ".ppm") {
+        return loadPpm(filename);
+    }
+    throw std::runtime_error("unknown image file extension " + filename);
+}
+
+/// Halve the first level of an uncompressed RGBA8 image with a box filter, the given number of times
+inline void downsampleImage(ImageData& image, uint32_t count) {
+    for (uint32_t n = 0; n < count && !image.compressed && (image.width() > 1 || image.height() > 1); n++) {
+        const ImageLevel& source = image.levels[0];
+        ImageLevel level;
+        level.width = std::max(1u, source.width / 2);
+        level.height = std::max(1u, source.height / 2);
+        level.size = levelSize(level.width, level.height, image.texelSize, false);
+
+        std::vector<unsigned char> data(level.size);
+        for (uint32_t y = 0; y < level.height; y++) {
+            const uint32_t y0 = std::min(y * 2, source.height - 1);
+            const uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+            for (uint32_t x = 0; x < level.width; x++) {
+                const uint32_t x0 = std::min(x * 2, source.width - 1);
+                const uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+                for (uint32_t c = 0; c < 4; c++) {
+                    const uint32_t sum = image.data[(y0 * source.width + x0) * 4 + c] + image.data[(y0 * source.width + x1) * 4 + c]
+                                       + image.data[(y1 * source.width + x0) * 4 + c] + image.data[(y1 * source.width + x1) * 4 + c];
+                    data[(y * level.width + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+                }
+            }
+        }
+        image.data.swap(data);
+        image.levels.assign(1, level);
+    }
+}
@@ -0,0 +1,499 @@
+/**
+ * @file    IndirectDrawBatcher.h
+ * @ingroup VulkanTest
+ * @brief   GPU indirect drawing of instances batched by pipeline and material from shared mesh buffers.
+ *
+ * Copyright (c) 2017 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include "VulkanMemory.h"
+#include "VulkanCapture.h"
+
+#include <vulkan/vulkan.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <cstring>
+#include <cstdint>
+
+/**
+ * Indirect drawing of instances of meshes merged into shared vertex and index "megabuffers"
+ *
+ * Optional per-instance data (bound as vertex binding 1, at the instance rate) is merged into a third megabuffer.
+ * The megabuffers live in device local memory, filled through a staging buffer on the graphics queue,
+ * while the indirect buffers are host visible and persistently mapped since they are rewritten each frame.
+ * Each frame, one VkDrawIndexedIndirectCommand is written per visible instance (merging consecutive instances of the same mesh),
+ * sorted in buckets of the same pipeline and material so that each bucket is submitted with a single vkCmdDrawIndexedIndirect.
+ * Falls back to one indirect draw per command without the multiDrawIndirect feature,
+ * and to direct draws without the drawIndirectFirstInstance feature (required to pass the instance index).
+ */
+class IndirectDrawBatcher {
+public:
+    /// Number of indirect buffers, so that commands are not overwritten while still in use by the GPU
+    static const uint32_t FRAME_COUNT = 2;
+
+    /// Consecutive draw commands sharing the same pipeline and material
+    struct Bucket {
+        VkPipeline  pipeline;       ///< Graphics pipeline to bind
+        uint32_t    material;       ///< Material identifier, bound by the user callback
+        uint32_t    firstCommand;   ///< Index of the first command of the bucket
+        uint32_t    commandCount;   ///< Number of commands of the bucket
+    };
+
+    /// Callback binding the resources (descriptor sets...) of a material
+    typedef std::function<void(VkCommandBuffer, uint32_t material)> BindMaterial;
+
+    /// Use the logical device created with the given features, uploading the meshes on the given graphics queue
+    void init(VkPhysicalDevice physicalDev, VkDevice dev, uint32_t graphicsQueueFamily, VkQueue graphicsQ,
+              const VkPhysicalDeviceFeatures& enabledFeatures) {
+        physicalDevice = physicalDev;
+        device = dev;
+        graphicsQueue = graphicsQ;
+        multiDrawIndirect = (enabledFeatures.multiDrawIndirect == VK_TRUE);
+        drawIndirectFirstInstance = (enabledFeatures.drawIndirectFirstInstance == VK_TRUE);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        maxDrawIndirectCount = multiDrawIndirect ? properties.limits.maxDrawIndirectCount : 1;
+
+        if (!drawIndirectFirstInstance) {
+            std::cout << "[init] Indirect drawing: drawIndirectFirstInstance not supported, using direct draws\n";
+        } else if (!multiDrawIndirect) {
+            std::cout << "[init] Indirect drawing: multiDrawIndirect not supported, using one draw per command\n";
+        } else {
+            std::cout << "[init] Indirect drawing: multiDrawIndirect up to " << maxDrawIndirectCount << " draws\n";
+        }
+
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = graphicsQueueFamily;
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &uploadPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create megabuffer upload command pool!");
+        }
+    }
+
+    /// Record the buffers created, the draw commands written and the draws recorded from now on
+    void setCapture(VulkanCapture* vulkanCapture) {
+        capture = vulkanCapture;
+    }
+
+    /// Destroy all the buffers
+    void cleanup() {
+        destroyCapturedBuffer(vertexBuffer, vertexBufferMemory);
+        destroyCapturedBuffer(indexBuffer, indexBufferMemory);
+        destroyCapturedBuffer(instanceBuffer, instanceBufferMemory);
+        for (auto& frame : frames) {
+            if (frame.mapped) {
+                vkUnmapMemory(device, frame.memory);
+                frame.mapped = nullptr;
+            }
+            destroyCapturedBuffer(frame.buffer, frame.memory);
+            frame.capacity = 0;
+        }
+        if (uploadPool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(device, uploadPool, nullptr);
+            uploadPool = VK_NULL_HANDLE;
+        }
+    }
+
+    /// Append a mesh to the megabuffers, returning its index (all meshes share the same vertex layout)
+    uint32_t addMesh(const void* vertexData, uint32_t vertexStride, uint32_t vertexCount, const std::vector<uint32_t>& indices) {
+        if (vertices.empty()) {
+            stride = vertexStride;
+        } else if (vertexStride != stride) {
+            throw std::runtime_error("all meshes of the megabuffer must use the same vertex layout!");
+        }
+
+        MeshRange mesh;
+        mesh.firstIndex = static_cast<uint32_t>(indexData.size());
+        mesh.indexCount = static_cast<uint32_t>(indices.size());
+        mesh.vertexOffset = static_cast<int32_t>(vertices.size() / stride);
+        meshes.push_back(mesh);
+
+        const char* data = static_cast<const char*>(vertexData);
+        vertices.insert(vertices.end(), data, data + static_cast<size_t>(vertexCount) * vertexStride);
+        indexData.insert(indexData.end(), indices.begin(), indices.end());
+        buffersUploaded = false;
+
+        return static_cast<uint32_t>(meshes.size() - 1);
+    }
+
+    /**
+     * Add an instance of a mesh, returning its index (also used as firstInstance to index per-instance data in shaders)
+     *
+     * @param mesh          Index of the mesh returned by addMesh()
+     * @param pipeline      Graphics pipeline drawing the instance
+     * @param material      Material identifier, passed to the BindMaterial callback
+     * @param instanceData  Optional per-instance data read from vertex binding 1, either given for all instances or none
+     * @param instanceDataStride Size of the per-instance data, the same for all instances
+     */
+    uint32_t addInstance(uint32_t mesh, VkPipeline pipeline, uint32_t material,
+                         const void* instanceData = nullptr, uint32_t instanceDataStride = 0) {
+        if (mesh >= meshes.size()) {
+            throw std::runtime_error("invalid mesh index!");
+        }
+        if (instances.empty()) {
+            instanceStride = instanceData ? instanceDataStride : 0;
+        } else if ((instanceData ? instanceDataStride : 0) != instanceStride) {
+            throw std::runtime_error("all instances of the megabuffer must use the same per-instance data layout!");
+        }
+        if (instanceData) {
+            const char* data = static_cast<const char*>(instanceData);
+            instanceBytes.insert(instanceBytes.end(), data, data + instanceStride);
+            buffersUploaded = false;
+        }
+
+        Instance instance;
+        instance.mesh = mesh;
+        instance.pipeline = pipeline;
+        instance.material = material;
+        instances.push_back(instance);
+        return static_cast<uint32_t>(instances.size() - 1);
+    }
+
+    /// Replace a pipeline by another one (rebuilt with reloaded shaders) in all instances and in the last built frame
+    void replacePipeline(VkPipeline oldPipeline, VkPipeline newPipeline) {
+        for (auto& instance : instances) {
+            if (instance.pipeline == oldPipeline) {
+                instance.pipeline = newPipeline;
+            }
+        }
+        for (auto& bucket : buckets) {
+            if (bucket.pipeline == oldPipeline) {
+                bucket.pipeline = newPipeline;
+            }
+        }
+    }
+
+    /**
+     * Write draw commands of the visible instances into the indirect buffer of the frame
+     *
+     * @param frameIndex        Frame slot, whose indirect buffer is rewritten (or reallocated if too small)
+     * @param visibleInstances  Indices of the instances to draw
+     * @param frameFence        Fence signaled by the last submission reading the indirect buffer of this frame slot,
+     *                          waited for before writing into it (not reset, this is left to the submitter)
+     */
+    void buildCommands(uint32_t frameIndex, const std::vector<uint32_t>& visibleInstances, VkFence frameFence) {
+        if (!buffersUploaded && !meshes.empty()) {
+            uploadBuffers();
+        }
+
+        // Sort instances by pipeline, then material, then index, so that consecutive instances of a mesh can be merged
+        sortedInstances = visibleInstances;
+        std::sort(sortedInstances.begin(), sortedInstances.end(), [this](uint32_t lhs, uint32_t rhs) {
+            const Instance& left = instances[lhs];
+            const Instance& right = instances[rhs];
+            if (left.pipeline != right.pipeline) {
+                return std::less<VkPipeline>()(left.pipeline, right.pipeline);
+            }
+            if (left.material != right.material) {
+                return left.material < right.material;
+            }
+            return lhs < rhs;
+        });
+
+        commands.clear();
+        buckets.clear();
+        for (const uint32_t index : sortedInstances) {
+            const Instance& instance = instances[index];
+            const MeshRange& mesh = meshes[instance.mesh];
+
+            if (buckets.empty() || buckets.back().pipeline != instance.pipeline || buckets.back().material != instance.material) {
+                Bucket bucket;
+                bucket.pipeline = instance.pipeline;
+                bucket.material = instance.material;
+                bucket.firstCommand = static_cast<uint32_t>(commands.size());
+                bucket.commandCount = 0;
+                buckets.push_back(bucket);
+            } else {
+                VkDrawIndexedIndirectCommand& last = commands.back();
+                if (last.firstIndex == mesh.firstIndex && last.vertexOffset == mesh.vertexOffset &&
+                    last.firstInstance + last.instanceCount == index) {
+                    last.instanceCount++;
+                    continue;
+                }
+            }
+
+            VkDrawIndexedIndirectCommand command;
+            command.indexCount = mesh.indexCount;
+            command.instanceCount = 1;
+            command.firstIndex = mesh.firstIndex;
+            command.vertexOffset = mesh.vertexOffset;
+            command.firstInstance = index;
+            commands.push_back(command);
+            buckets.back().commandCount++;
+        }
+
+        currentFrame = frameIndex % FRAME_COUNT;
+        if (drawIndirectFirstInstance && !commands.empty()) {
+            vkWaitForFences(device, 1, &frameFence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            FrameBuffer& frame = frames[currentFrame];
+            reserveIndirectBuffer(frame, commands.size());
+            memcpy(frame.mapped, commands.data(), commands.size() * sizeof(VkDrawIndexedIndirectCommand));
+            if (capture) {
+                capture->uploadBuffer(frame.buffer, 0, commands.data(), commands.size() * sizeof(VkDrawIndexedIndirectCommand));
+            }
+        }
+    }
+
+    /// Record the draws of the last built frame into a command buffer, inside a render pass
+    void recordDraws(VkCommandBuffer commandBuffer, const BindMaterial& bindMaterial = BindMaterial()) const {
+        if (commands.empty()) {
+            return;
+        }
+
+        const VkDeviceSize vertexOffset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &vertexOffset);
+        if (instanceBuffer != VK_NULL_HANDLE) {
+            vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer, &vertexOffset);
+        }
+        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+        if (capture) {
+            capture->bindVertexBuffer(0, vertexBuffer, vertexOffset);
+            if (instanceBuffer != VK_NULL_HANDLE) {
+                capture->bindVertexBuffer(1, instanceBuffer, vertexOffset);
+            }
+            capture->bindIndexBuffer(indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+        }
+
+        const uint32_t commandStride = sizeof(VkDrawIndexedIndirectCommand);
+        for (const auto& bucket : buckets) {
+            if (bucket.pipeline != VK_NULL_HANDLE) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bucket.pipeline);
+                if (capture) {
+                    capture->bindPipeline(bucket.pipeline);
+                }
+            }
+            if (bindMaterial) {
+                bindMaterial(commandBuffer, bucket.material);
+            }
+
+            if (drawIndirectFirstInstance) {
+                // Without multiDrawIndirect, maxDrawIndirectCount is 1: one indirect draw per command
+                for (uint32_t first = 0; first < bucket.commandCount; first += maxDrawIndirectCount) {
+                    const uint32_t drawCount = std::min(maxDrawIndirectCount, bucket.commandCount - first);
+                    const VkDeviceSize offset = static_cast<VkDeviceSize>(bucket.firstCommand + first) * commandStride;
+                    vkCmdDrawIndexedIndirect(commandBuffer, frames[currentFrame].buffer, offset, drawCount, commandStride);
+                    if (capture) {
+                        capture->drawIndexedIndirect(frames[currentFrame].buffer, offset, drawCount, commandStride);
+                    }
+                }
+            } else {
+                for (uint32_t i = bucket.firstCommand; i < bucket.firstCommand + bucket.commandCount; i++) {
+                    const VkDrawIndexedIndirectCommand& command = commands[i];
+                    vkCmdDrawIndexed(commandBuffer, command.indexCount, command.instanceCount,
+                        command.firstIndex, command.vertexOffset, command.firstInstance);
+                    if (capture) {
+                        capture->drawIndexed(command.indexCount, command.instanceCount,
+                            command.firstIndex, command.vertexOffset, command.firstInstance);
+                    }
+                }
+            }
+        }
+    }
+
+    /// Number of draw commands of the last built frame
+    size_t commandCount() const {
+        return commands.size();
+    }
+
+    /// Number of pipeline and material buckets of the last built frame
+    size_t bucketCount() const {
+        return buckets.size();
+    }
+
+private:
+    /// Range of a mesh inside the megabuffers
+    struct MeshRange {
+        uint32_t    firstIndex;     ///< Index of the first index of the mesh in the index buffer
+        uint32_t    indexCount;     ///< Number of indices of the mesh
+        int32_t     vertexOffset;   ///< Index of the first vertex of the mesh in the vertex buffer
+    };
+
+    /// Instance of a mesh drawn with a pipeline and a material
+    struct Instance {
+        uint32_t    mesh;           ///< Index of the mesh
+        VkPipeline  pipeline;       ///< Graphics pipeline
+        uint32_t    material;       ///< Material identifier
+    };
+
+    /// Host visible buffer holding the data of a device local buffer until its copy is completed
+    struct StagingBuffer {
+        VkBuffer        buffer      = VK_NULL_HANDLE;   ///< Source of the copy
+        VkDeviceMemory  memory      = VK_NULL_HANDLE;   ///< Host visible memory of the buffer
+    };
+
+    /// Persistently mapped indirect buffer of a frame
+    struct FrameBuffer {
+        VkBuffer        buffer      = VK_NULL_HANDLE;   ///< Indirect draw commands
+        VkDeviceMemory  memory      = VK_NULL_HANDLE;   ///< Host visible memory of the buffer
+        void*           mapped      = nullptr;          ///< Mapped memory
+        size_t          capacity    = 0;                ///< Capacity in number of commands
+    };
+
+    /// (Re)create the vertex, index and instance megabuffers with the content of all meshes and instances
+    void uploadBuffers() {
+        if (vertexBuffer != VK_NULL_HANDLE || indexBuffer != VK_NULL_HANDLE || instanceBuffer != VK_NULL_HANDLE) {
+            // Meshes or instances added after the first frame: the previous megabuffers may still be read by frames in flight
+            vkQueueWaitIdle(graphicsQueue);
+        }
+        destroyCapturedBuffer(vertexBuffer, vertexBufferMemory);
+        destroyCapturedBuffer(indexBuffer, indexBufferMemory);
+        destroyCapturedBuffer(instanceBuffer, instanceBufferMemory);
+
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = uploadPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate megabuffer upload command buffer!");
+        }
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        StagingBuffer vertexStaging;
+        StagingBuffer indexStaging;
+        StagingBuffer instanceStaging;
+        if (!vertices.empty()) {
+            createDeviceLocalBuffer(commandBuffer, vertices.data(), vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                vertexStaging, vertexBuffer, vertexBufferMemory);
+        }
+        if (!indexData.empty()) {
+            createDeviceLocalBuffer(commandBuffer, indexData.data(), indexData.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                indexStaging, indexBuffer, indexBufferMemory);
+        }
+        if (!instanceBytes.empty()) {
+            createDeviceLocalBuffer(commandBuffer, instanceBytes.data(), instanceBytes.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                instanceStaging, instanceBuffer, instanceBufferMemory);
+        }
+
+        // Make the copies visible to the vertex input stage of the following frames
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+            1, &barrier, 0, nullptr, 0, nullptr);
+        vkEndCommandBuffer(commandBuffer);
+
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VkFence fence = VK_NULL_HANDLE;
+        if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create megabuffer upload fence!");
+        }
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+        const VkResult result = vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence);
+        if (result == VK_SUCCESS) {
+            vkWaitForFences(device, 1, &fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        }
+        vkDestroyFence(device, fence, nullptr);
+        vkFreeCommandBuffers(device, uploadPool, 1, &commandBuffer);
+        destroyBuffer(device, vertexStaging.buffer, vertexStaging.memory);
+        destroyBuffer(device, indexStaging.buffer, indexStaging.memory);
+        destroyBuffer(device, instanceStaging.buffer, instanceStaging.memory);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit megabuffer upload!");
+        }
+
+        std::cout << "[init] Megabuffers: " << meshes.size() << " meshes, " << vertices.size() << " bytes of vertices, "
+            << indexData.size() << " indices, " << instanceBytes.size() << " bytes of instance data\n";
+        buffersUploaded = true;
+    }
+
+    /// Create a device local buffer, recording the copy of the data from a new host visible staging buffer
+    void createDeviceLocalBuffer(VkCommandBuffer commandBuffer, const void* data, size_t size, VkBufferUsageFlags usage,
+                                 StagingBuffer& staging, VkBuffer& buffer, VkDeviceMemory& memory) {
+        createBuffer(physicalDevice, device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging.buffer, staging.memory);
+        void* mapped = nullptr;
+        vkMapMemory(device, staging.memory, 0, size, 0, &mapped);
+        memcpy(mapped, data, size);
+        vkUnmapMemory(device, staging.memory);
+
+        createBuffer(physicalDevice, device, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            buffer, memory);
+        VkBufferCopy region = {};
+        region.size = size;
+        vkCmdCopyBuffer(commandBuffer, staging.buffer, buffer, 1, &region);
+        if (capture) {
+            capture->createBuffer(buffer, size, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            capture->uploadBuffer(buffer, 0, data, size);
+        }
+    }
+
+    /// Destroy a buffer and free its memory, recording it in the capture
+    void destroyCapturedBuffer(VkBuffer& buffer, VkDeviceMemory& memory) {
+        if (capture) {
+            capture->destroyBuffer(buffer);
+        }
+        destroyBuffer(device, buffer, memory);
+    }
+
+    /// Grow the indirect buffer of a frame to hold at least the given number of commands (once its fence is signaled)
+    void reserveIndirectBuffer(FrameBuffer& frame, size_t count) {
+        if (count <= frame.capacity) {
+            return;
+        }
+        if (frame.mapped) {
+            vkUnmapMemory(device, frame.memory);
+            frame.mapped = nullptr;
+        }
+        destroyCapturedBuffer(frame.buffer, frame.memory);
+
+        frame.capacity = std::max<size_t>(count, frame.capacity * 2);
+        const VkDeviceSize size = frame.capacity * sizeof(VkDrawIndexedIndirectCommand);
+        createBuffer(physicalDevice, device, size, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frame.buffer, frame.memory);
+        vkMapMemory(device, frame.memory, 0, size, 0, &frame.mapped);
+        if (capture) {
+            capture->createBuffer(frame.buffer, size, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        }
+    }
+
+private:
+    VkPhysicalDevice                            physicalDevice      = VK_NULL_HANDLE;   ///< Physical Device (GPU)
+    VkDevice                                    device              = VK_NULL_HANDLE;   ///< Logical Device
+    VkQueue                                     graphicsQueue       = VK_NULL_HANDLE;   ///< Queue of the megabuffer uploads
+    VkCommandPool                               uploadPool          = VK_NULL_HANDLE;   ///< Command buffers of the uploads
+    bool                                        multiDrawIndirect   = false;    ///< Multiple draws per indirect call
+    bool                                        drawIndirectFirstInstance = false; ///< Non zero firstInstance in indirect draws
+    uint32_t                                    maxDrawIndirectCount = 1;       ///< Maximum draws per indirect call
+    uint32_t                                    stride              = 0;        ///< Size of a vertex, shared by all meshes
+    std::vector<char>                           vertices;                       ///< Vertices of all meshes
+    std::vector<uint32_t>                       indexData;                      ///< Indices of all meshes
+    std::vector<MeshRange>                      meshes;                         ///< Ranges of the meshes in the megabuffers
+    std::vector<char>                           instanceBytes;                  ///< Per-instance data of all instances
+    uint32_t                                    instanceStride      = 0;        ///< Size of the per-instance data (0 if none)
+    bool                                        buffersUploaded     = false;    ///< Megabuffers are up to date
+    VkBuffer                                    vertexBuffer        = VK_NULL_HANDLE;   ///< Vertex megabuffer
+    VkDeviceMemory                              vertexBufferMemory  = VK_NULL_HANDLE;   ///< Memory of the vertex megabuffer
+    VkBuffer                                    indexBuffer         = VK_NULL_HANDLE;   ///< Index megabuffer
+    VkDeviceMemory                              indexBufferMemory   = VK_NULL_HANDLE;   ///< Memory of the index megabuffer
+    VkBuffer                                    instanceBuffer      = VK_NULL_HANDLE;   ///< Per-instance data megabuffer
+    VkDeviceMemory                              instanceBufferMemory = VK_NULL_HANDLE;  ///< Memory of the instance megabuffer
+    std::vector<Instance>                       instances;                      ///< All instances
+    std::vector<uint32_t>                       sortedInstances;                ///< Visible instances sorted by bucket
+    std::vector<VkDrawIndexedIndirectCommand>   commands;                       ///< Draw commands of the last built frame
+    std::vector<Bucket>                         buckets;                        ///< Buckets of the last built frame
+    FrameBuffer                                 frames[FRAME_COUNT];            ///< Indirect buffers of the frames
+    uint32_t                                    currentFrame        = 0;        ///< Frame of the last built commands
+    VulkanCapture*                              capture             = nullptr;  ///< Optional capture of the buffers
+};
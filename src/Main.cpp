@@ -12,16 +12,71 @@
 #include <iostream>
 #include <stdexcept>
 #include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <string>
+#include <algorithm>
 
 #include "HelloTriangleApplication.h"
+#include "RenderFarm.h"
 
 /**
  * Entry point of the application
- * 
+ *
+ * Usage: VulkanTutorial [--capture trace] [--farm [contexts] [seconds]]
+ *
+ * --capture records the Vulkan work into a binary trace file, to be replayed by VulkanReplay
+ * --farm runs headless render contexts on separate threads (one per hardware thread by default, during 5 seconds)
+ *
+ * Options can be given in any order.
+ *
  * @return 0
  */
-int main() {
+int main(int argc, char* argv[]) {
+    std::string captureFile;
+    bool farmMode = false;
+    // hardware_concurrency() returns 0 when it cannot be determined
+    int contextCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    double seconds = 5.0;
+    bool validOptions = true;
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "--capture") == 0) && (i + 1 < argc)) {
+            captureFile = argv[++i];
+        } else if (strcmp(argv[i], "--farm") == 0) {
+            farmMode = true;
+            // Optional values of the option, in this order
+            if ((i + 1 < argc) && (argv[i + 1][0] != '-')) {
+                contextCount = atoi(argv[++i]);
+                if ((i + 1 < argc) && (argv[i + 1][0] != '-')) {
+                    seconds = atof(argv[++i]);
+                }
+            }
+        } else {
+            validOptions = false;
+        }
+    }
+    if (!validOptions || contextCount <= 0 || seconds <= 0.0) {
+        std::cerr << "Usage: " << argv[0] << " [--capture trace] [--farm [contexts] [seconds]]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (farmMode) {
+        RenderFarm farm;
+        farm.setCaptureFile(captureFile);
+
+        try {
+            farm.run(static_cast<size_t>(contextCount), seconds);
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
+
     HelloTriangleApplication app;
+    app.setCaptureFile(captureFile);
 
     try {
         app.run();
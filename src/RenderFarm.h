@@ -0,0 +1,181 @@
+/**
+ * @file    RenderFarm.h
+ * @ingroup VulkanTest
+ * @brief   Batch rendering with independent headless render contexts running on separate threads.
+ *
+ * Copyright (c) 2017 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include "HeadlessRenderContext.h"
+#include "VulkanCapture.h"
+#include "TestScene.h"
+
+#include <vulkan/vulkan.h>
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <stdexcept>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <exception>
+#include <cstdint>
+
+/**
+ * Render farm mode: N headless render contexts on N threads, sharing one Vulkan instance and the physical device query results
+ *
+ * Each context owns its Logical Device and queue, so that threads never synchronize with each other while rendering
+ * the test scene of the windowed application (from the same SPIR V shaders, loaded once and shared by all the contexts).
+ * Runs with 1, 2, 4... up to N contexts to report the aggregate frames per second and how it scales with N.
+ */
+class RenderFarm {
+public:
+    /// Record the frames of a single context into a binary trace file, during an extra run before the measured ones
+    void setCaptureFile(const std::string& filename) {
+        captureFilename = filename;
+    }
+
+    /// Measure the throughput of 1, 2, 4... up to contextCount contexts, each run lasting the given number of seconds
+    void run(size_t contextCount, double seconds) {
+        vertShaderCode = loadSpirv("shaders/shader.vert.spv");
+        fragShaderCode = loadSpirv("shaders/shader.frag.spv");
+        instance = PhysicalDeviceInfo::createInstance("Render Farm");
+        try {
+            const PhysicalDeviceInfo info = PhysicalDeviceInfo::pick(instance);
+            if (!captureFilename.empty()) {
+                // The capture overhead (copies and file writes) must not skew the single context baseline of the scaling
+                capture.open(captureFilename);
+                runContexts(info, 1, seconds, &capture);
+                capture.close();
+                std::cout << "[farm] Captured a single context run into " << captureFilename << " (not measured)\n";
+            }
+
+            std::vector<size_t> counts;
+            for (size_t count = 1; count < contextCount; count *= 2) {
+                counts.push_back(count);
+            }
+            counts.push_back(contextCount);
+
+            double singleFps = 0.0;
+            for (const size_t count : counts) {
+                const double fps = runContexts(info, count, seconds, nullptr);
+                if (count == 1) {
+                    singleFps = fps;
+                }
+                const double scaling = (singleFps > 0.0) ? fps / singleFps : 0.0;
+                std::ostringstream report;
+                report << "[farm] " << std::setw(3) << count << " contexts: " << std::fixed << std::setprecision(1)
+                    << std::setw(9) << fps << " fps (" << std::setw(8) << fps / count << " per context) scaling "
+                    << std::setprecision(2) << scaling << "x efficiency " << std::setprecision(0)
+                    << (100.0 * scaling / count) << "%\n";
+                std::cout << report.str();
+            }
+        } catch (...) {
+            capture.close();
+            vkDestroyInstance(instance, nullptr);
+            instance = VK_NULL_HANDLE;
+            throw;
+        }
+        vkDestroyInstance(instance, nullptr);
+        instance = VK_NULL_HANDLE;
+    }
+
+private:
+    /// Render with the given number of contexts in parallel during the given time, returning the aggregate frames per second
+    double runContexts(const PhysicalDeviceInfo& info, size_t count, double seconds, VulkanCapture* firstContextCapture) {
+        std::mutex mutex;                       // protects the following variables, up to the error
+        std::condition_variable condition;      // signaled when a context is ready, when started, and on error
+        size_t readyCount = 0;
+        bool started = false;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point lastStop;
+        std::exception_ptr error;
+        std::atomic<bool> stopping(false);
+        std::atomic<uint64_t> frameCount(0);
+
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < count; i++) {
+            threads.emplace_back([&, i] {
+                HeadlessRenderContext context;
+                if (i == 0) {
+                    context.setCapture(firstContextCapture);
+                }
+                bool ready = false;
+                try {
+                    // Device creation runs in parallel too, then all threads start rendering at the same time
+                    context.init(info, IMAGE_WIDTH, IMAGE_HEIGHT, vertShaderCode, fragShaderCode);
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        ready = true;
+                        readyCount++;
+                        condition.notify_all();
+                        condition.wait(lock, [&] { return started; });
+                    }
+                    uint64_t frames = 0;
+                    while (!stopping) {
+                        context.renderFrame(frames++);
+                    }
+                    // Frames in progress at the deadline are completed and counted, but not the cleanup of the context
+                    const auto stop = std::chrono::steady_clock::now();
+                    frameCount += frames;
+                    std::lock_guard<std::mutex> lock(mutex);
+                    lastStop = std::max(lastStop, stop);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    if (!ready) {
+                        readyCount++;
+                    }
+                    stopping = true;
+                    condition.notify_all();
+                }
+                context.cleanup();
+            });
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&] { return readyCount == count; });
+            start = std::chrono::steady_clock::now();
+            lastStop = start;
+            started = true;
+            condition.notify_all();
+            const auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(seconds));
+            condition.wait_until(lock, deadline, [&] { return stopping.load(); });
+        }
+        stopping = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        const double elapsed = std::chrono::duration<double>(lastStop - start).count();
+        return (elapsed > 0.0) ? frameCount / elapsed : 0.0;
+    }
+
+private:
+    /// Dimensions of the offscreen images
+    static const uint32_t IMAGE_WIDTH = 800;
+    static const uint32_t IMAGE_HEIGHT = 600;
+
+    VkInstance      instance = VK_NULL_HANDLE;  ///< Vulkan instance shared by all the contexts
+    std::vector<char> vertShaderCode;           ///< SPIR V byte code of the vertex shader, shared by all the contexts
+    std::vector<char> fragShaderCode;           ///< SPIR V byte code of the fragment shader, shared by all the contexts
+    std::string     captureFilename;            ///< Trace file to record (none by default)
+    VulkanCapture   capture;                    ///< Capture of the unmeasured single context run
+};
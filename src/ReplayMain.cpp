@@ -0,0 +1,46 @@
+/**
+ * @file    ReplayMain.cpp
+ * @ingroup VulkanTest
+ * @brief   Headless replay of a trace captured by VulkanTutorial --capture.
+ *
+ * Copyright (c) 2017 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+
+#include <iostream>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+
+#include "TraceReplayer.h"
+
+/**
+ * Entry point of the replay tool
+ *
+ * Usage: VulkanReplay trace [--paced]
+ *
+ * Replays the trace as fast as possible, or at the original pacing with --paced
+ *
+ * @return 0
+ */
+int main(int argc, char* argv[]) {
+    const bool paced = (argc == 3) && (strcmp(argv[2], "--paced") == 0);
+    if ((argc != 2) && !paced) {
+        std::cerr << "Usage: " << argv[0] << " trace [--paced]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    TraceReplayer replayer;
+
+    try {
+        replayer.run(argv[1], paced);
+    }
+    catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
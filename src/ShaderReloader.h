@@ -0,0 +1,267 @@
+/**
+ * @file    ShaderReloader.h
+ * @ingroup VulkanTest
+ * @brief   Development mode watching the GLSL shaders to recompile them and rebuild their pipelines on a background thread.
+ *
+ * Copyright (c) 2017 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include "VulkanCapture.h"
+
+#include <vulkan/vulkan.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <cstdio>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Watch the GLSL sources of the shaders (*.vert and *.frag) for changes, recompile them and rebuild the affected pipelines
+ *
+ * Everything runs on a background thread: the render loop only polls for rebuilt pipelines at frame boundaries
+ * with takePipeline(), which never blocks. When a shader fails to compile, the compiler output is printed
+ * and the previous pipeline is kept. Only supported on Linux (inotify).
+ */
+class ShaderReloader {
+public:
+    /// Build a pipeline from the freshly compiled SPIR V shaders (called on the background thread)
+    typedef std::function<VkPipeline()> BuildPipeline;
+
+    ~ShaderReloader() {
+        stop();
+    }
+
+    /// Register a pipeline to rebuild when one of its shaders (source file names) changes, returning its index
+    size_t addPipeline(const std::vector<std::string>& shaders, const BuildPipeline& build) {
+        if (watcher.joinable()) {
+            throw std::runtime_error("pipelines must be registered before watching the shaders!");
+        }
+        std::unique_ptr<WatchedPipeline> pipeline(new WatchedPipeline);
+        pipeline->shaders.insert(shaders.begin(), shaders.end());
+        pipeline->build = build;
+        pipelines.push_back(std::move(pipeline));
+        return pipelines.size() - 1;
+    }
+
+    /// Record the destruction of the rebuilt pipelines never taken by the render loop
+    void setCapture(VulkanCapture* vulkanCapture) {
+        capture = vulkanCapture;
+    }
+
+    /// Start watching the shader sources, compiling them with the given compiler into the binary directory
+    void start(VkDevice dev, const std::string& sourceDirectory, const std::string& binaryDirectory, const std::string& compilerPath) {
+        device = dev;
+        sourceDir = sourceDirectory;
+        binaryDir = binaryDirectory;
+        compiler = compilerPath;
+#ifdef __linux__
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotifyFd < 0) {
+            throw std::runtime_error("failed to initialize inotify!");
+        }
+        if (inotify_add_watch(inotifyFd, sourceDir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            close(inotifyFd);
+            inotifyFd = -1;
+            throw std::runtime_error("failed to watch shaders in " + sourceDir);
+        }
+        std::cout << "[reload] Watching shaders in " << sourceDir << std::endl;
+        stopping = false;
+        watcher = std::thread([this] { watch(); });
+#else
+        std::cout << "[reload] Shader hot reload is only supported on Linux\n";
+#endif
+    }
+
+    /// Stop watching, destroying the rebuilt pipelines not taken by the render loop
+    void stop() {
+        if (watcher.joinable()) {
+            stopping = true;
+            watcher.join();
+        }
+#ifdef __linux__
+        if (inotifyFd >= 0) {
+            close(inotifyFd);
+            inotifyFd = -1;
+        }
+#endif
+        for (auto& pipeline : pipelines) {
+            const VkPipeline pending = pipeline->pending.exchange(VK_NULL_HANDLE);
+            if (pending != VK_NULL_HANDLE) {
+                destroyPipeline(pending);
+            }
+        }
+    }
+
+    /// Pipeline rebuilt since the last call, or VK_NULL_HANDLE (never blocks): the caller takes ownership
+    VkPipeline takePipeline(size_t index) {
+        return pipelines[index]->pending.exchange(VK_NULL_HANDLE);
+    }
+
+private:
+    /// Pipeline depending on some shaders
+    struct WatchedPipeline {
+        std::set<std::string>   shaders;                    ///< Source file names of the shaders
+        BuildPipeline           build;                      ///< Rebuild the pipeline
+        std::atomic<VkPipeline> pending{VK_NULL_HANDLE};    ///< Rebuilt pipeline waiting for the render loop
+    };
+
+#ifdef __linux__
+    /// Background thread: wait for shader changes, then recompile them and rebuild the affected pipelines
+    void watch() {
+        while (!stopping) {
+            std::set<std::string> changed;
+            if (!readEvents(changed, 100)) {
+                continue;
+            }
+            // Editors often save in several steps: gather the events of the whole burst
+            while (readEvents(changed, 50)) {
+            }
+
+            std::set<std::string> compiled;
+            for (const auto& shader : changed) {
+                if (compile(shader)) {
+                    compiled.insert(shader);
+                }
+            }
+
+            for (auto& pipeline : pipelines) {
+                rebuild(*pipeline, changed, compiled);
+            }
+        }
+    }
+
+    /// Wait up to the timeout for inotify events, adding the names of the changed shaders, returning true if any
+    bool readEvents(std::set<std::string>& changed, int timeoutMs) {
+        pollfd pollFd = {};
+        pollFd.fd = inotifyFd;
+        pollFd.events = POLLIN;
+        if (poll(&pollFd, 1, timeoutMs) <= 0) {
+            return false;
+        }
+
+        // Buffer aligned as required to walk through the inotify_event structures
+        alignas(inotify_event) char buffer[4096];
+        bool found = false;
+        ssize_t length;
+        while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0) {
+            for (const char* ptr = buffer; ptr < buffer + length; ) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
+                if (event->len == 0) {
+                    continue;
+                }
+                const std::string name(event->name);
+                if (hasExtension(name, ".vert") || hasExtension(name, ".frag")) {
+                    changed.insert(name);
+                    found = true;
+                }
+            }
+        }
+        return found;
+    }
+#endif
+
+    /// Check the extension of a file name
+    static bool hasExtension(const std::string& name, const std::string& extension) {
+        return (name.size() > extension.size()) && (name.compare(name.size() - extension.size(), extension.size(), extension) == 0);
+    }
+
+    /// Compile a shader into SPIR V, only replacing the binary on success, returning false with the compiler output on failure
+    bool compile(const std::string& shader) {
+        const std::string source = sourceDir + "/" + shader;
+        const std::string binary = binaryDir + "/" + shader + ".spv";
+        const std::string temporary = binary + ".tmp";
+        const std::string command = "\"" + compiler + "\" -V \"" + source + "\" -o \"" + temporary + "\" 2>&1";
+
+        const auto start = std::chrono::steady_clock::now();
+        std::string output;
+        int status = -1;
+#ifdef __linux__
+        FILE* pipe = popen(command.c_str(), "r");
+        if (pipe) {
+            char line[256];
+            while (fgets(line, sizeof(line), pipe)) {
+                output += line;
+            }
+            status = pclose(pipe);
+        }
+#endif
+        if ((status != 0) || (std::rename(temporary.c_str(), binary.c_str()) != 0)) {
+            std::remove(temporary.c_str());
+            std::cerr << "[reload] Failed to compile " << source << ", keeping the previous pipeline:\n" << output;
+            return false;
+        }
+
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::ostringstream report;
+        report << "[reload] Compiled " << shader << " in " << ms << " ms\n";
+        std::cout << report.str();
+        return true;
+    }
+
+    /// Rebuild a pipeline if some of its shaders changed and all of them compiled
+    void rebuild(WatchedPipeline& pipeline, const std::set<std::string>& changed, const std::set<std::string>& compiled) {
+        bool affected = false;
+        for (const auto& shader : changed) {
+            if (pipeline.shaders.count(shader)) {
+                if (!compiled.count(shader)) {
+                    return;
+                }
+                affected = true;
+            }
+        }
+        if (!affected) {
+            return;
+        }
+
+        try {
+            const VkPipeline rebuilt = pipeline.build();
+            // Replace a previous rebuild never taken by the render loop, thus never used
+            const VkPipeline previous = pipeline.pending.exchange(rebuilt);
+            if (previous != VK_NULL_HANDLE) {
+                destroyPipeline(previous);
+            }
+            std::cout << "[reload] Pipeline rebuilt\n";
+        } catch (const std::exception& e) {
+            std::cerr << "[reload] Failed to rebuild the pipeline, keeping the previous one: " << e.what() << std::endl;
+        }
+    }
+
+    /// Destroy a rebuilt pipeline, recording it in the capture (where it was recorded by the build function)
+    void destroyPipeline(VkPipeline pipeline) {
+        if (capture) {
+            capture->destroyPipeline(pipeline);
+        }
+        vkDestroyPipeline(device, pipeline, nullptr);
+    }
+
+private:
+    std::vector<std::unique_ptr<WatchedPipeline>> pipelines;    ///< Pipelines to rebuild
+    VkDevice            device      = VK_NULL_HANDLE;           ///< Logical Device owning the pipelines
+    std::string         sourceDir;                              ///< Directory of the GLSL sources
+    std::string         binaryDir;                              ///< Directory of the SPIR V binaries
+    std::string         compiler;                               ///< Path to glslangValidator
+    int                 inotifyFd   = -1;                       ///< inotify instance watching the source directory
+    std::atomic<bool>   stopping{false};                        ///< Ask the background thread to stop
+    std::thread         watcher;                                ///< Background thread
+    VulkanCapture*      capture     = nullptr;                  ///< Optional capture of the destroyed pipelines
+};
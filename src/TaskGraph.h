@@ -0,0 +1,191 @@
+/**
+ * @file    TaskGraph.h
+ * @ingroup VulkanTest
+ * @brief   Dependency-aware execution of tasks on a thread pool, with per-task timings.
+ *
+ * Copyright (c) 2017 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+
+/**
+ * Graph of tasks, each one started as soon as all its dependencies are completed
+ *
+ * Tasks run on the worker threads of a pool, except the ones flagged to run on the main thread (the one calling run()),
+ * as required for instance by GLFW window creation.
+ */
+class TaskGraph {
+public:
+    /// Index of a task in the graph
+    typedef size_t TaskId;
+
+    /// Add a task depending on previously added tasks
+    TaskId add(const std::string& name, const std::function<void()>& function,
+               const std::vector<TaskId>& dependencies = std::vector<TaskId>(), bool onMainThread = false) {
+        const TaskId id = tasks.size();
+        Task task;
+        task.name = name;
+        task.function = function;
+        task.onMainThread = onMainThread;
+        task.remainingDependencies = dependencies.size();
+        tasks.push_back(task);
+        for (const TaskId dependency : dependencies) {
+            if (dependency >= id) {
+                throw std::runtime_error("task dependency must be added before " + name);
+            }
+            tasks[dependency].dependents.push_back(id);
+        }
+        return id;
+    }
+
+    /// Execute all tasks, then rethrow the first exception thrown by a task (if any) once the running ones are completed
+    void run(ThreadPool& pool) {
+        start = std::chrono::steady_clock::now();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        for (TaskId id = 0; id < tasks.size(); id++) {
+            if (tasks[id].remainingDependencies == 0) {
+                ready.push_back(id);
+            }
+        }
+
+        std::deque<TaskId> readyOnMainThread;
+        size_t runningCount = 0;
+        size_t completedCount = 0;
+        while (completedCount < tasks.size()) {
+            // After a failure, no new task is started
+            if (error) {
+                if (runningCount == 0) {
+                    break;
+                }
+                condition.wait(lock);
+                continue;
+            }
+
+            // Dispatch ready tasks to the workers first, so that they run concurrently with the main thread
+            while (!ready.empty()) {
+                const TaskId id = ready.front();
+                ready.pop_front();
+                if (tasks[id].onMainThread) {
+                    readyOnMainThread.push_back(id);
+                } else {
+                    runningCount++;
+                    pool.enqueue([this, id, &runningCount, &completedCount] {
+                        execute(id);
+                        std::lock_guard<std::mutex> guard(mutex);
+                        complete(id);
+                        runningCount--;
+                        completedCount++;
+                        condition.notify_one();
+                    });
+                }
+            }
+
+            if (!readyOnMainThread.empty()) {
+                const TaskId id = readyOnMainThread.front();
+                readyOnMainThread.pop_front();
+                lock.unlock();
+                execute(id);
+                lock.lock();
+                complete(id);
+                completedCount++;
+            } else if (completedCount < tasks.size()) {
+                condition.wait(lock);
+            }
+        }
+        end = std::chrono::steady_clock::now();
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    /// Print the start time and duration of each task, sorted by start time
+    void report(const std::string& prefix) const {
+        std::vector<const Task*> sorted;
+        for (const auto& task : tasks) {
+            sorted.push_back(&task);
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const Task* lhs, const Task* rhs) {
+            return lhs->begin < rhs->begin;
+        });
+
+        double tasksMs = 0.0;
+        std::ostringstream report;
+        report << std::fixed << std::setprecision(1);
+        for (const Task* task : sorted) {
+            const double startMs = std::chrono::duration<double, std::milli>(task->begin - start).count();
+            const double durationMs = std::chrono::duration<double, std::milli>(task->end - task->begin).count();
+            tasksMs += durationMs;
+            report << prefix << " " << std::left << std::setw(28) << task->name << std::right
+                << " start " << std::setw(7) << startMs << " ms, duration " << std::setw(7) << durationMs << " ms"
+                << (task->onMainThread ? " (main thread)\n" : "\n");
+        }
+        report << prefix << " " << tasks.size() << " tasks in " << std::chrono::duration<double, std::milli>(end - start).count()
+            << " ms (" << tasksMs << " ms if run sequentially)\n";
+        std::cout << report.str();
+    }
+
+private:
+    /// Task with its dependents and timings
+    struct Task {
+        std::string                             name;                       ///< Name for the report
+        std::function<void()>                   function;                   ///< Work to do
+        bool                                    onMainThread = false;       ///< Must run on the thread calling run()
+        size_t                                  remainingDependencies = 0;  ///< Number of dependencies not completed yet
+        std::vector<TaskId>                     dependents;                 ///< Tasks depending on this one
+        std::chrono::steady_clock::time_point   begin;                      ///< Start of the execution
+        std::chrono::steady_clock::time_point   end;                        ///< End of the execution
+    };
+
+    /// Run a task, timing it and catching its exception
+    void execute(TaskId id) {
+        Task& task = tasks[id];
+        task.begin = std::chrono::steady_clock::now();
+        try {
+            task.function();
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+        task.end = std::chrono::steady_clock::now();
+    }
+
+    /// Make ready the dependents of a completed task (mutex locked)
+    void complete(TaskId id) {
+        for (const TaskId dependent : tasks[id].dependents) {
+            if (--tasks[dependent].remainingDependencies == 0) {
+                ready.push_back(dependent);
+            }
+        }
+    }
+
+private:
+    std::vector<Task>                       tasks;      ///< All the tasks
+    std::deque<TaskId>                      ready;      ///< Tasks with all their dependencies completed
+    std::mutex                              mutex;      ///< Protect the ready queue, the counters and the error
+    std::condition_variable                 condition;  ///< Signal the completion of a task to run()
+    std::exception_ptr                      error;      ///< First exception thrown by a task
+    std::chrono::steady_clock::time_point   start;      ///< Start of run()
+    std::chrono::steady_clock::time_point   end;        ///< End of run()
+};
@@ -0,0 +1,348 @@
+/**
+ * @file    TestScene.h
+ * @ingroup VulkanTest
+ * @brief   Test scene drawn by the windowed application and by the headless render contexts of the render farm.
+ *
+ * Copyright (c) 2017 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include "VulkanCapture.h"
+
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+const uint32_t SPIRV_MAGIC = 0x07230203; ///< First word of any SPIR V binary
+
+const uint32_t SCENE_GRID_SIZE = 128;   ///< Instances per side of the square grid of the test scene
+const float SCENE_GRID_SPACING = 1.5f;  ///< Distance between two instances of the grid
+
+const glm::vec3 CAMERA_POSITION(2.0f, 2.0f, 2.0f); ///< Position of the camera, looking at the origin
+
+/// Texture of each material of the test scene, alternating over the grid
+const std::vector<std::string> MATERIAL_TEXTURES = {
+    "textures/checker.ppm",
+    "textures/bricks.ppm"
+};
+
+/// Distance up to which the full resolution of a texture is requested, one mip level coarser each time it doubles
+const float TEXTURE_FULL_RESOLUTION_DISTANCE = 4.0f;
+
+/// Vertex of the meshes of the megabuffers
+struct Vertex {
+    glm::vec2 pos;      ///< Position in model space
+    glm::vec2 texCoord; ///< Texture coordinates
+};
+
+/// Per-instance data of the megabuffers
+struct InstanceData {
+    glm::vec3 offset;   ///< Position of the instance in world space
+};
+
+/// Vertices of the triangle instanced over the grid (indices 0, 1, 2)
+inline std::vector<Vertex> sceneTriangle() {
+    return {
+        {{0.0f, -0.5f}, {0.5f, 0.0f}},
+        {{0.5f, 0.5f}, {1.0f, 1.0f}},
+        {{-0.5f, 0.5f}, {0.0f, 1.0f}}
+    };
+}
+
+/// Position of the instance at the given column and row of the grid, centered on the origin
+inline glm::vec3 sceneInstanceOffset(uint32_t x, uint32_t y) {
+    const float origin = -0.5f * SCENE_GRID_SPACING * (SCENE_GRID_SIZE - 1);
+    return glm::vec3(origin + x * SCENE_GRID_SPACING, origin + y * SCENE_GRID_SPACING, 0.0f);
+}
+
+/// Material of the instance at the given column and row of the grid, index in MATERIAL_TEXTURES
+inline uint32_t sceneInstanceMaterial(uint32_t x, uint32_t y) {
+    return (x + y) % static_cast<uint32_t>(MATERIAL_TEXTURES.size());
+}
+
+/// View projection of the camera looking at the origin, for a viewport of the given aspect ratio
+inline glm::mat4 sceneViewProj(float aspect) {
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
+    proj[1][1] *= -1; // Y clip coordinate is inverted in Vulkan compared to OpenGL
+    const glm::mat4 view = glm::lookAt(CAMERA_POSITION, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+    return proj * view;
+}
+
+/// The view projection matrix as a push constant
+inline VkPushConstantRange viewProjPushConstantRange() {
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(glm::mat4);
+    return pushConstantRange;
+}
+
+/// Read content of a file (SPIR V binary byte code) into a vector
+inline std::vector<char> readFile(const std::string& filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file!");
+    }
+
+    const size_t fileSize = (size_t) file.tellg();
+    std::vector<char> buffer(fileSize);
+    file.seekg(0);
+    file.read(buffer.data(), fileSize);
+
+    return buffer;
+}   // file closed by RAII design
+
+/// Check that a binary looks like SPIR V byte code: a stream of 32 bits words starting with the magic number
+inline void validateSpirv(const std::vector<char>& code, const std::string& filename) {
+    uint32_t magic = 0;
+    if (code.size() >= sizeof(magic)) {
+        memcpy(&magic, code.data(), sizeof(magic));
+    }
+    if ((code.size() < sizeof(magic)) || (code.size() % sizeof(uint32_t) != 0) || (magic != SPIRV_MAGIC)) {
+        throw std::runtime_error("invalid SPIR V byte code in " + filename);
+    }
+}
+
+/// Read and validate a SPIR V binary shader
+inline std::vector<char> loadSpirv(const std::string& filename) {
+    std::vector<char> code = readFile(filename);
+    validateSpirv(code, filename);
+    return code;
+}
+
+/// Create a shader module from a binary SPIR V compiled shader
+inline VkShaderModule createShaderModule(VkDevice device, const std::vector<char>& code) {
+    VkShaderModuleCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shader module!");
+    }
+
+    return shaderModule;
+}
+
+/// Create the layout of the descriptor set of a material: the texture sampled by the fragment shader
+inline VkDescriptorSetLayout createMaterialSetLayout(VkDevice device) {
+    VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
+    samplerLayoutBinding.binding = 0;
+    samplerLayoutBinding.descriptorCount = 1;
+    samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    samplerLayoutBinding.pImmutableSamplers = nullptr;
+    samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &samplerLayoutBinding;
+
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+    return descriptorSetLayout;
+}
+
+/// Point the descriptor set of a material to an image view of its texture, sampled in the shader read only layout by default
+inline void writeMaterialDescriptor(VkDevice device, VkDescriptorSet descriptorSet, VkImageView view, VkSampler sampler,
+                                    VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.imageLayout = imageLayout;
+    imageInfo.imageView = view;
+    imageInfo.sampler = sampler;
+
+    VkWriteDescriptorSet descriptorWrite = {};
+    descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrite.dstSet = descriptorSet;
+    descriptorWrite.dstBinding = 0;
+    descriptorWrite.dstArrayElement = 0;
+    descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrite.descriptorCount = 1;
+    descriptorWrite.pImageInfo = &imageInfo;
+    vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
+
+/// Create the pipeline layout of the scene: the descriptor set of a material and the view projection push constant
+inline VkPipelineLayout createScenePipelineLayout(VkDevice device, VkDescriptorSetLayout descriptorSetLayout) {
+    const VkPushConstantRange pushConstantRange = viewProjPushConstantRange();
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+    return pipelineLayout;
+}
+
+/**
+ * Build the pipeline drawing the scene from SPIR V shaders, into the color attachment of the first subpass of a render pass
+ *
+ * Thread safe, only reading its parameters (also called on the shader reloader thread).
+ *
+ * @param colorFormat   Format of the color attachment, recorded in the capture
+ * @param capture       Optional capture of the pipeline, with its shaders
+ */
+inline VkPipeline createScenePipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkRenderPass renderPass, VkFormat colorFormat,
+                                      const std::vector<char>& vertCode, const std::vector<char>& fragCode, VulkanCapture* capture) {
+    // Programable stages:
+    const VkShaderModule vertShaderModule = createShaderModule(device, vertCode);
+    const VkShaderModule fragShaderModule = createShaderModule(device, fragCode);
+
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
+    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = vertShaderModule;
+    vertShaderStageInfo.pName = "main";
+
+    VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
+    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragShaderStageInfo.module = fragShaderModule;
+    fragShaderStageInfo.pName = "main";
+
+    const VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+
+    // Static configurable stages:
+    // Vertex Input: positions and texture coordinates read from the vertex megabuffer of the draw batcher (binding 0)
+    // and offsets from its instance megabuffer (binding 1)
+    VkVertexInputBindingDescription bindingDescriptions[2] = {};
+    bindingDescriptions[0].binding = 0;
+    bindingDescriptions[0].stride = sizeof(Vertex);
+    bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    bindingDescriptions[1].binding = 1;
+    bindingDescriptions[1].stride = sizeof(InstanceData);
+    bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+    VkVertexInputAttributeDescription attributeDescriptions[3] = {};
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[0].offset = offsetof(Vertex, pos);
+    attributeDescriptions[1].binding = 1;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[1].offset = offsetof(InstanceData, offset);
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 2;
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions;
+    vertexInputInfo.vertexAttributeDescriptionCount = 3;
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
+
+    // We only use the triangle topology for now
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // Viewport and scissor are dynamic states set at draw time,
+    // so that the pipeline can be compiled before the swapchain extent is known
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = nullptr;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = nullptr;
+
+    const VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+    VkPipelineDynamicStateCreateInfo dynamicState = {};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_NONE; // the flat triangles of the scene are seen from both sides
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_FALSE;
+    rasterizer.depthBiasConstantFactor = 0.0f; // Optional
+    rasterizer.depthBiasClamp = 0.0f; // Optional
+    rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampling.minSampleShading = 1.0f; // Optional
+    multisampling.pSampleMask = nullptr; // Optional
+    multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
+    multisampling.alphaToOneEnable = VK_FALSE; // Optional
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+    colorBlendAttachment.colorWriteMask =
+        VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; // Optional
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = {};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.renderPass = renderPass;
+    pipelineInfo.subpass = 0;
+
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    const VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+
+    vkDestroyShaderModule(device, fragShaderModule, nullptr);
+    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+    if (capture) {
+        capture->createPipeline(pipeline, colorFormat, pipelineInfo, viewProjPushConstantRange(), true, vertCode, fragCode);
+    }
+
+    return pipeline;
+}
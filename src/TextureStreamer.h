@@ -0,0 +1,1001 @@
+/**
+ * @file    TextureStreamer.h
+ * @ingroup VulkanTest
+ * @brief   Asynchronous texture streaming with GPU mip generation under a memory budget.
+ *
+ * Copyright (c) 2017 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include "ThreadPool.h"
+#include "ImageLoader.h"
+#include "VulkanMemory.h"
+#include "VulkanCapture.h"
+
+#include <vulkan/vulkan.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <future>
+#include <utility>
+#include <chrono>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <cstdint>
+
+/// Index of a texture of the TextureStreamer
+typedef uint32_t TextureHandle;
+
+/**
+ * Streaming of textures from image files, under a configurable device memory budget
+ *
+ * - image files are decoded into staging buffers by a dedicated pool of low priority threads,
+ *   so that they never delay the per-frame jobs (such as the frustum culling) of the other worker threads
+ * - staging buffers are copied into images on the transfer queue
+ * - mip chains of uncompressed images are generated on the graphics queue with vkCmdBlitImage
+ *   (with a nearest filter if the format does not support linear filtering, or on the CPU if it cannot be blitted)
+ * - block-compressed KTX files are used when the device supports textureCompressionBC (else the ".ppm" file of the same name)
+ *
+ * Until its data arrives, a texture uses a 1x1 white default image, then a small low resolution fallback
+ * (mip levels of FALLBACK_SIZE pixels and below) is kept resident while the finer mip levels are streamed in and out:
+ * - below the low watermark, the most recently used textures are streamed in up to their requested level,
+ *   each load reserving its share of the budget until its images are allocated
+ * - over the budget, the least recently used ones are streamed out one level at a time, down to the low watermark
+ *
+ * All public methods are to be called from the render thread, that also owns the queues and the command pools.
+ * The worker threads only decode the image files and create, map and fill the staging buffers,
+ * which Vulkan allows concurrently with the render thread (no externally synchronized object is involved).
+ */
+class TextureStreamer {
+public:
+    /// Maximum dimension of the low resolution fallback levels, always kept resident
+    static const uint32_t FALLBACK_SIZE = 64;
+    /// Number of updates before destroying a replaced image, so that it is not in use by the GPU anymore
+    static const uint32_t RETIRE_DELAY = 3;
+    /// Maximum number of images being decoded at the same time
+    static const size_t MAX_PENDING_LOADS = 4;
+    /// Number of low priority threads decoding the images, apart from the workers of the per-frame jobs
+    static const size_t LOADER_THREAD_COUNT = 2;
+    /// Percentage of the budget where streaming out stops and streaming in starts, so that they do not alternate
+    static const VkDeviceSize LOW_WATERMARK_PERCENT = 90;
+
+    /// Create the command pools, the sampler and the default image
+    void init(VkPhysicalDevice physicalDev, VkDevice dev, uint32_t graphicsQueueFamily, VkQueue graphicsQ,
+              uint32_t transferQueueFamily, VkQueue transferQ, const VkPhysicalDeviceFeatures& enabledFeatures, VkDeviceSize budgetBytes) {
+        physicalDevice = physicalDev;
+        device = dev;
+        graphicsFamily = graphicsQueueFamily;
+        graphicsQueue = graphicsQ;
+        transferFamily = transferQueueFamily;
+        transferQueue = transferQ;
+        compressionSupported = (enabledFeatures.textureCompressionBC == VK_TRUE);
+        budget = budgetBytes;
+        std::cout << "[init] Texture streaming: budget " << (budget / (1024 * 1024)) << " MB, transfer queue family " << transferFamily
+            << ", block compression " << (compressionSupported ? "supported" : "not supported") << std::endl;
+
+        graphicsPool = createCommandPool(graphicsFamily);
+        transferPool = createCommandPool(transferFamily);
+
+        VkSamplerCreateInfo samplerInfo = {};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+        samplerInfo.anisotropyEnable = VK_FALSE;
+        samplerInfo.maxAnisotropy = 1.0f;
+        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+        samplerInfo.compareEnable = VK_FALSE;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture sampler!");
+        }
+
+        // 1x1 white image used by textures until their data arrives
+        ImageData white;
+        white.format = VK_FORMAT_R8G8B8A8_UNORM;
+        white.texelSize = 4;
+        white.data.assign(4, 255);
+        ImageLevel level;
+        level.width = 1;
+        level.height = 1;
+        level.size = 4;
+        white.levels.push_back(level);
+        LoadResult result = stageImage(physicalDevice, device, describe(white), white, 0, true, budget);
+        PendingOp op = submitUpload(result);
+        vkWaitForFences(device, 1, &op.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+        defaultImage = op.fallback;
+        releaseOp(op);
+    }
+
+    /// Wait for pending work, then destroy all the images and Vulkan objects
+    void cleanup() {
+        for (auto& load : loads) {
+            try {
+                LoadResult result = load.result.get();
+                destroyBuffer(device, result.staging, result.stagingMemory);
+            } catch (const std::runtime_error&) {
+                // already reported by update(), nothing to release
+            }
+        }
+        loads.clear();
+        reservedBytes = 0;
+        for (auto& op : ops) {
+            vkWaitForFences(device, 1, &op.fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
+            destroyImage(op.fallback);
+            destroyImage(op.resident);
+            releaseOp(op);
+        }
+        ops.clear();
+        for (auto& retired : retiredImages) {
+            destroyImage(retired.image);
+        }
+        retiredImages.clear();
+        for (auto& texture : textures) {
+            destroyImage(texture.fallback);
+            destroyImage(texture.resident);
+        }
+        textures.clear();
+        destroyImage(defaultImage);
+
+        if (sampler != VK_NULL_HANDLE) {
+            vkDestroySampler(device, sampler, nullptr);
+            sampler = VK_NULL_HANDLE;
+        }
+        if (graphicsPool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(device, graphicsPool, nullptr);
+            graphicsPool = VK_NULL_HANDLE;
+        }
+        if (transferPool != VK_NULL_HANDLE) {
+            vkDestroyCommandPool(device, transferPool, nullptr);
+            transferPool = VK_NULL_HANDLE;
+        }
+    }
+
+    /// Register a texture to be streamed from an image file (".ktx" or ".ppm")
+    TextureHandle load(const std::string& filename) {
+        Texture texture;
+        texture.filename = filename;
+        const size_t dot = filename.find_last_of('.');
+        if (!compressionSupported && dot != std::string::npos && filename.substr(dot) == ".ktx") {
+            texture.filename = filename.substr(0, dot) + ".ppm";
+            std::cout << "[texture] Block compression not supported, using " << texture.filename << std::endl;
+        }
+        texture.lastUsed = frameCounter;
+        textures.push_back(texture);
+        return static_cast<TextureHandle>(textures.size() - 1);
+    }
+
+    /// Mark a texture as used by the current frame (least recently used textures are the first streamed out)
+    void touch(TextureHandle handle) {
+        textures[handle].lastUsed = frameCounter;
+    }
+
+    /// Set the finest mip level needed for a texture (0 by default for the full resolution)
+    void requestLevel(TextureHandle handle, uint32_t level) {
+        textures[handle].wantedLevel = level;
+    }
+
+    /// Record the images created, uploaded and copied from now on
+    void setCapture(VulkanCapture* vulkanCapture) {
+        capture = vulkanCapture;
+    }
+
+    /// Change the memory budget: textures are streamed in or out by the following updates
+    void setBudget(VkDeviceSize budgetBytes) {
+        budget = budgetBytes;
+    }
+
+    /// Device memory used by the images
+    VkDeviceSize usedMemory() const {
+        return usedBytes;
+    }
+
+    /// Sampler to use with all textures
+    VkSampler getSampler() const {
+        return sampler;
+    }
+
+    /// Best image view currently available for the texture: full resolution, low resolution fallback, or default
+    VkImageView getImageView(TextureHandle handle) const {
+        const Texture& texture = textures[handle];
+        if (texture.resident.view != VK_NULL_HANDLE) {
+            return texture.resident.view;
+        } else if (texture.fallback.view != VK_NULL_HANDLE) {
+            return texture.fallback.view;
+        }
+        return defaultImage.view;
+    }
+
+    /// Image of the view returned by getImageView()
+    VkImage getImage(TextureHandle handle) const {
+        const Texture& texture = textures[handle];
+        if (texture.resident.image != VK_NULL_HANDLE) {
+            return texture.resident.image;
+        } else if (texture.fallback.image != VK_NULL_HANDLE) {
+            return texture.fallback.image;
+        }
+        return defaultImage.image;
+    }
+
+    /// Finest mip level of the texture currently resident (the number of levels of the fallback if not loaded yet)
+    uint32_t residentLevel(TextureHandle handle) const {
+        const Texture& texture = textures[handle];
+        return (texture.resident.image != VK_NULL_HANDLE) ? texture.resident.baseLevel : texture.desc.fallbackLevel;
+    }
+
+    /// Once per frame: start uploads of decoded images, complete finished transfers, and stream textures in or out
+    void update() {
+        frameCounter++;
+
+        // Upload the images decoded by the worker threads
+        for (size_t i = 0; i < loads.size();) {
+            if (loads[i].result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                i++;
+                continue;
+            }
+            const TextureHandle handle = loads[i].handle;
+            Texture& texture = textures[handle];
+            // From now on, the images of the load are allocated and counted in the used memory (or the load failed)
+            reservedBytes -= loads[i].reserved;
+            try {
+                LoadResult result = loads[i].result.get();
+                texture.desc = result.desc;
+                texture.described = true;
+                PendingOp op = submitUpload(result);
+                op.handle = handle;
+                ops.push_back(op);
+            } catch (const std::runtime_error& e) {
+                std::cerr << "[texture] " << e.what() << std::endl;
+                texture.failed = true;
+                texture.busy = false;
+            }
+            loads.erase(loads.begin() + i);
+        }
+
+        // Install the images of the completed transfers
+        for (size_t i = 0; i < ops.size();) {
+            if (vkGetFenceStatus(device, ops[i].fence) != VK_SUCCESS) {
+                i++;
+                continue;
+            }
+            PendingOp& op = ops[i];
+            Texture& texture = textures[op.handle];
+            if (op.fallback.image != VK_NULL_HANDLE) {
+                retire(texture.fallback);
+                texture.fallback = op.fallback;
+            }
+            if (op.replacesResident) {
+                retire(texture.resident);
+                texture.resident = op.resident;
+            }
+            texture.busy = false;
+            releaseOp(op);
+            ops.erase(ops.begin() + i);
+        }
+
+        // Destroy replaced images once they are not in use by the GPU anymore
+        for (size_t i = 0; i < retiredImages.size();) {
+            if (retiredImages[i].frame + RETIRE_DELAY <= frameCounter) {
+                destroyImage(retiredImages[i].image);
+                retiredImages.erase(retiredImages.begin() + i);
+            } else {
+                i++;
+            }
+        }
+
+        const VkDeviceSize projected = liveBytes() + reservedBytes;
+        if (projected > budget) {
+            streamOut();
+        } else if (projected < lowWatermark()) {
+            streamIn();
+        }
+    }
+
+private:
+    /// Dimensions and format of a texture, known once its file has been decoded
+    struct TextureDesc {
+        VkFormat    format          = VK_FORMAT_UNDEFINED;  ///< Vulkan format of the texels
+        bool        compressed      = false;    ///< Block-compressed format
+        uint32_t    texelSize       = 0;        ///< Bytes per texel, or per block
+        uint32_t    width           = 0;        ///< Width of the first level
+        uint32_t    height          = 0;        ///< Height of the first level
+        uint32_t    levelCount      = 0;        ///< Number of mip levels of the full chain
+        uint32_t    fallbackLevel   = 0;        ///< First level of the low resolution fallback
+
+        /// Width of a mip level
+        uint32_t levelWidth(uint32_t level) const {
+            return std::max(1u, width >> level);
+        }
+
+        /// Height of a mip level
+        uint32_t levelHeight(uint32_t level) const {
+            return std::max(1u, height >> level);
+        }
+
+        /// Bytes of the mip levels from the given one to the end of the chain
+        VkDeviceSize chainSize(uint32_t baseLevel) const {
+            VkDeviceSize size = 0;
+            for (uint32_t level = baseLevel; level < levelCount; level++) {
+                size += levelSize(levelWidth(level), levelHeight(level), texelSize, compressed);
+            }
+            return size;
+        }
+    };
+
+    /// Image with its memory and its view over a range of mip levels of a texture
+    struct GpuImage {
+        VkImage         image       = VK_NULL_HANDLE;   ///< Image
+        VkDeviceMemory  memory      = VK_NULL_HANDLE;   ///< Dedicated memory of the image
+        VkImageView     view        = VK_NULL_HANDLE;   ///< View of all the levels of the image
+        VkDeviceSize    size        = 0;                ///< Size of the memory
+        uint32_t        baseLevel   = 0;                ///< Level of the texture stored in the first level of the image
+        uint32_t        levelCount  = 0;                ///< Number of levels of the image
+    };
+
+    /// Texture streamed from an image file
+    struct Texture {
+        std::string     filename;                   ///< Image file to decode
+        TextureDesc     desc;                       ///< Dimensions and format
+        bool            described   = false;        ///< The image file has already been decoded once
+        bool            busy        = false;        ///< A decode or a transfer is in progress
+        bool            failed      = false;        ///< The image file could not be decoded
+        uint32_t        wantedLevel = 0;            ///< Finest mip level requested
+        uint64_t        lastUsed    = 0;            ///< Frame of the last use
+        GpuImage        fallback;                   ///< Low resolution levels, always resident
+        GpuImage        resident;                   ///< Finer levels, streamed in and out
+    };
+
+    /// Staging buffer filled by a worker thread, with the copies to the images of a texture
+    struct LoadResult {
+        TextureDesc                     desc;                           ///< Dimensions and format of the texture
+        uint32_t                        baseLevel       = 0;            ///< First level of the resident image (fallbackLevel if none)
+        VkFilter                        mipFilter       = VK_FILTER_LINEAR; ///< Filter of the blits generating the missing levels
+        VkBuffer                        staging         = VK_NULL_HANDLE;   ///< Host visible staging buffer
+        VkDeviceMemory                  stagingMemory   = VK_NULL_HANDLE;   ///< Memory of the staging buffer
+        std::vector<VkBufferImageCopy>  fallbackRegions;                ///< Copies to the fallback image (none if already resident)
+        std::vector<VkBufferImageCopy>  residentRegions;                ///< Copies to the resident image (none if not enough budget)
+    };
+
+    /// Transfer in flight on the GPU
+    struct PendingOp {
+        TextureHandle   handle          = 0;                ///< Texture
+        VkFence         fence           = VK_NULL_HANDLE;   ///< Signaled by the last submission
+        VkSemaphore     semaphore       = VK_NULL_HANDLE;   ///< Orders the transfer before the graphics submission
+        VkCommandBuffer transferCmd     = VK_NULL_HANDLE;   ///< Copies from the staging buffer
+        VkCommandBuffer graphicsCmd     = VK_NULL_HANDLE;   ///< Mip generation and layout transitions
+        VkBuffer        staging         = VK_NULL_HANDLE;   ///< Staging buffer to destroy after the transfer
+        VkDeviceMemory  stagingMemory   = VK_NULL_HANDLE;   ///< Memory of the staging buffer
+        GpuImage        fallback;                           ///< New fallback image (if any)
+        GpuImage        resident;                           ///< New resident image (if any)
+        bool            replacesResident = false;           ///< Install the new resident image (or none) when completed
+    };
+
+    /// Image file being decoded by a worker thread
+    struct PendingLoad {
+        TextureHandle           handle      = 0;    ///< Texture
+        VkDeviceSize            reserved    = 0;    ///< Budget reserved for the resident image, until its allocation
+        std::future<LoadResult> result;             ///< Staging buffer filled by the worker thread
+    };
+
+    /// Image to destroy after a delay
+    struct RetiredImage {
+        GpuImage        image;          ///< Image replaced
+        uint64_t        frame;          ///< Frame of the replacement
+    };
+
+    /// Describe the full mip chain of a decoded image
+    static TextureDesc describe(const ImageData& image) {
+        TextureDesc desc;
+        desc.format = image.format;
+        desc.compressed = image.compressed;
+        desc.texelSize = image.texelSize;
+        desc.width = image.width();
+        desc.height = image.height();
+        // Block-compressed formats cannot be blitted: their mip levels must come from the file
+        desc.levelCount = image.compressed ? static_cast<uint32_t>(image.levels.size()) : mipLevelCount(desc.width, desc.height);
+        desc.fallbackLevel = 0;
+        while (desc.fallbackLevel + 1 < desc.levelCount &&
+               std::max(desc.levelWidth(desc.fallbackLevel), desc.levelHeight(desc.fallbackLevel)) > FALLBACK_SIZE) {
+            desc.fallbackLevel++;
+        }
+        return desc;
+    }
+
+    /// Decode an image file and copy the levels to upload into a staging buffer (run by the worker threads)
+    static LoadResult decodeImage(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& filename,
+                                  uint32_t wantedLevel, bool needFallback, VkDeviceSize availableBytes) {
+        ImageData image = loadImage(filename);
+        if (image.compressed && image.levels.size() < mipLevelCount(image.width(), image.height())) {
+            std::cout << "[texture] " << filename << " has an incomplete mip chain\n";
+        }
+        return stageImage(physicalDevice, device, describe(image), image, wantedLevel, needFallback, availableBytes);
+    }
+
+    /// Select the finest level fitting in the available memory, and copy the levels to upload into a staging buffer (worker threads)
+    static LoadResult stageImage(VkPhysicalDevice physicalDevice, VkDevice device, const TextureDesc& desc, ImageData& image,
+                                 uint32_t wantedLevel, bool needFallback, VkDeviceSize availableBytes) {
+        LoadResult result;
+        result.desc = desc;
+        result.baseLevel = std::min(wantedLevel, desc.fallbackLevel);
+        while (result.baseLevel < desc.fallbackLevel && desc.chainSize(result.baseLevel) > availableBytes) {
+            result.baseLevel++;
+        }
+
+        // Blitting (and linear filtering) optimal tiling images are optional features of most formats
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(physicalDevice, desc.format, &formatProperties);
+        const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+        const bool blitSupported = (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+        result.mipFilter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ?
+            VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+        // Uncompressed images are downsampled to the first level to upload, the others are generated on the GPU,
+        // or prebuilt on the CPU if the format cannot be blitted
+        struct Chunk {
+            const unsigned char*    data;
+            size_t                  size;
+            uint32_t                level;
+            bool                    fallback;
+        };
+        std::vector<Chunk> chunks;
+        std::vector<std::vector<unsigned char>> levelData;
+        if (image.compressed) {
+            // The resident image holds all the levels from its base, including the ones of the fallback
+            for (uint32_t level = result.baseLevel; level < desc.levelCount; level++) {
+                Chunk chunk = { &image.data[image.levels[level].offset], image.levels[level].size, level, false };
+                if (result.baseLevel < desc.fallbackLevel) {
+                    chunks.push_back(chunk);
+                }
+                if (needFallback && level >= desc.fallbackLevel) {
+                    chunk.fallback = true;
+                    chunks.push_back(chunk);
+                }
+            }
+        } else {
+            // Only the first level of each image is uploaded, unless the whole chain is prebuilt
+            const uint32_t residentEnd = blitSupported ? result.baseLevel + 1 : desc.levelCount;
+            const uint32_t fallbackEnd = blitSupported ? desc.fallbackLevel + 1 : desc.levelCount;
+            const uint32_t levelEnd = needFallback ? std::max(residentEnd, fallbackEnd) : residentEnd;
+            downsampleImage(image, result.baseLevel);
+            levelData.push_back(image.data);
+            for (uint32_t level = result.baseLevel + 1; level < levelEnd; level++) {
+                downsampleImage(image, 1);
+                levelData.push_back(image.data);
+            }
+            if (result.baseLevel < desc.fallbackLevel) {
+                for (uint32_t level = result.baseLevel; level < residentEnd; level++) {
+                    const std::vector<unsigned char>& data = levelData[level - result.baseLevel];
+                    Chunk chunk = { data.data(), data.size(), level, false };
+                    chunks.push_back(chunk);
+                }
+            }
+            if (needFallback) {
+                for (uint32_t level = desc.fallbackLevel; level < fallbackEnd; level++) {
+                    const std::vector<unsigned char>& data = levelData[level - result.baseLevel];
+                    Chunk chunk = { data.data(), data.size(), level, true };
+                    chunks.push_back(chunk);
+                }
+            }
+        }
+
+        // Offsets in the staging buffer must be multiples of 4 and of the texel (block) size
+        VkDeviceSize stagingSize = 0;
+        std::vector<VkDeviceSize> offsets;
+        for (const auto& chunk : chunks) {
+            offsets.push_back(stagingSize);
+            stagingSize += (chunk.size + 15) & ~static_cast<VkDeviceSize>(15);
+        }
+        if (stagingSize == 0) {
+            return result;
+        }
+
+        createBuffer(physicalDevice, device, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, result.staging, result.stagingMemory);
+        void* mapped = nullptr;
+        vkMapMemory(device, result.stagingMemory, 0, stagingSize, 0, &mapped);
+        for (size_t i = 0; i < chunks.size(); i++) {
+            memcpy(static_cast<unsigned char*>(mapped) + offsets[i], chunks[i].data, chunks[i].size);
+
+            VkBufferImageCopy region = {};
+            region.bufferOffset = offsets[i];
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = { 0, 0, 0 };
+            region.imageExtent = { desc.levelWidth(chunks[i].level), desc.levelHeight(chunks[i].level), 1 };
+            if (chunks[i].fallback) {
+                region.imageSubresource.mipLevel = chunks[i].level - desc.fallbackLevel;
+                result.fallbackRegions.push_back(region);
+            } else {
+                region.imageSubresource.mipLevel = chunks[i].level - result.baseLevel;
+                result.residentRegions.push_back(region);
+            }
+        }
+        vkUnmapMemory(device, result.stagingMemory);
+
+        return result;
+    }
+
+    /// Stream out the least recently used textures by one level, until the projected memory usage is down to the low watermark
+    void streamOut() {
+        std::vector<TextureHandle> candidates;
+        for (size_t i = 0; i < textures.size(); i++) {
+            if (!textures[i].busy && textures[i].resident.image != VK_NULL_HANDLE) {
+                candidates.push_back(static_cast<TextureHandle>(i));
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [this](TextureHandle lhs, TextureHandle rhs) {
+            return textures[lhs].lastUsed < textures[rhs].lastUsed;
+        });
+
+        VkDeviceSize projected = liveBytes() + reservedBytes;
+        for (const TextureHandle handle : candidates) {
+            if (projected <= lowWatermark()) {
+                break;
+            }
+            Texture& texture = textures[handle];
+            const uint32_t newBase = texture.resident.baseLevel + 1;
+            projected -= std::min(projected, texture.resident.size);
+            if (newBase < texture.desc.fallbackLevel) {
+                projected += texture.desc.chainSize(newBase);
+                PendingOp op = submitStreamOut(texture, newBase);
+                op.handle = handle;
+                ops.push_back(op);
+                texture.busy = true;
+            } else {
+                // Only the low resolution fallback remains
+                retire(texture.resident);
+                texture.resident = GpuImage();
+            }
+        }
+    }
+
+    /// Stream in the most recently used textures up to their requested level, reserving their memory within the budget
+    void streamIn() {
+        std::vector<TextureHandle> candidates;
+        for (size_t i = 0; i < textures.size(); i++) {
+            const Texture& texture = textures[i];
+            if (!texture.busy && !texture.failed &&
+                (!texture.described || residentLevel(static_cast<TextureHandle>(i)) > std::min(texture.wantedLevel, texture.desc.fallbackLevel))) {
+                candidates.push_back(static_cast<TextureHandle>(i));
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [this](TextureHandle lhs, TextureHandle rhs) {
+            return textures[lhs].lastUsed > textures[rhs].lastUsed;
+        });
+
+        VkDeviceSize projected = liveBytes() + reservedBytes;
+        for (const TextureHandle handle : candidates) {
+            if (loads.size() >= MAX_PENDING_LOADS) {
+                break;
+            }
+            Texture& texture = textures[handle];
+            // Memory freed by the replaced image is available, but not the memory reserved by the other loads
+            const VkDeviceSize available = budget - std::min(budget, projected - texture.resident.size);
+            VkDeviceSize reservation = 0;
+            if (texture.described) {
+                if (texture.desc.chainSize(residentLevel(handle) - 1) > available) {
+                    continue; // not even one more level fits
+                }
+                reservation = std::min(available, texture.desc.chainSize(std::min(texture.wantedLevel, texture.desc.fallbackLevel)));
+            } else {
+                // Size unknown until decoded: share the available memory with the loads that could start after this one
+                reservation = available / (MAX_PENDING_LOADS - loads.size());
+            }
+            projected += reservation;
+            reservedBytes += reservation;
+
+            const VkPhysicalDevice physicalDev = physicalDevice;
+            const VkDevice dev = device;
+            const std::string filename = texture.filename;
+            const uint32_t wantedLevel = texture.wantedLevel;
+            const bool needFallback = (texture.fallback.image == VK_NULL_HANDLE);
+            PendingLoad load;
+            load.handle = handle;
+            load.reserved = reservation;
+            load.result = loaderPool.enqueue([=] {
+                return decodeImage(physicalDev, dev, filename, wantedLevel, needFallback, reservation);
+            });
+            loads.push_back(std::move(load));
+            texture.busy = true;
+        }
+    }
+
+    /// Memory usage below which textures are streamed in, and down to which they are streamed out
+    VkDeviceSize lowWatermark() const {
+        return budget / 100 * LOW_WATERMARK_PERCENT;
+    }
+
+    /// Memory used by the images, excluding the retired ones about to be destroyed
+    VkDeviceSize liveBytes() const {
+        VkDeviceSize retiredBytes = 0;
+        for (const auto& retired : retiredImages) {
+            retiredBytes += retired.image.size;
+        }
+        return usedBytes - retiredBytes;
+    }
+
+    /// Record and submit the copies of a staging buffer to new images, and the generation of their mip levels
+    PendingOp submitUpload(const LoadResult& result) {
+        PendingOp op;
+        op.staging = result.staging;
+        op.stagingMemory = result.stagingMemory;
+        if (!result.fallbackRegions.empty()) {
+            const uint32_t level = result.desc.fallbackLevel;
+            op.fallback = createImage(result.desc, level, result.desc.levelCount - level);
+        }
+        if (!result.residentRegions.empty()) {
+            const uint32_t level = result.baseLevel;
+            op.resident = createImage(result.desc, level, result.desc.levelCount - level);
+            op.replacesResident = true;
+        }
+        beginOp(op, true);
+
+        const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        recordUpload(op.transferCmd, op.graphicsCmd, result.staging, op.fallback, result.fallbackRegions, result.desc, result.mipFilter);
+        recordUpload(op.transferCmd, op.graphicsCmd, result.staging, op.resident, result.residentRegions, result.desc, result.mipFilter);
+        captureUpload(result, op.fallback, result.fallbackRegions);
+        captureUpload(result, op.resident, result.residentRegions);
+        vkEndCommandBuffer(op.transferCmd);
+        vkEndCommandBuffer(op.graphicsCmd);
+
+        VkSubmitInfo transferSubmit = {};
+        transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        transferSubmit.commandBufferCount = 1;
+        transferSubmit.pCommandBuffers = &op.transferCmd;
+        transferSubmit.signalSemaphoreCount = 1;
+        transferSubmit.pSignalSemaphores = &op.semaphore;
+        if (vkQueueSubmit(transferQueue, 1, &transferSubmit, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit texture upload!");
+        }
+
+        VkSubmitInfo graphicsSubmit = {};
+        graphicsSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        graphicsSubmit.waitSemaphoreCount = 1;
+        graphicsSubmit.pWaitSemaphores = &op.semaphore;
+        graphicsSubmit.pWaitDstStageMask = &waitStage;
+        graphicsSubmit.commandBufferCount = 1;
+        graphicsSubmit.pCommandBuffers = &op.graphicsCmd;
+        if (vkQueueSubmit(graphicsQueue, 1, &graphicsSubmit, op.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit texture mip generation!");
+        }
+        return op;
+    }
+
+    /// Record the copies to an image on the transfer queue, then the mip generation on the graphics queue
+    void recordUpload(VkCommandBuffer transferCmd, VkCommandBuffer graphicsCmd, VkBuffer staging, const GpuImage& image,
+                      const std::vector<VkBufferImageCopy>& regions, const TextureDesc& desc, VkFilter mipFilter) const {
+        if (image.image == VK_NULL_HANDLE) {
+            return;
+        }
+        imageBarrier(transferCmd, image.image, 0, image.levelCount, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        vkCmdCopyBufferToImage(transferCmd, staging, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(regions.size()), regions.data());
+
+        // Generate the missing levels by blitting each one from the previous one
+        const uint32_t uploadedLevels = static_cast<uint32_t>(regions.size());
+        for (uint32_t level = uploadedLevels; level < image.levelCount; level++) {
+            imageBarrier(graphicsCmd, image.image, level - 1, 1,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+            VkImageBlit blit = {};
+            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blit.srcSubresource.mipLevel = level - 1;
+            blit.srcSubresource.baseArrayLayer = 0;
+            blit.srcSubresource.layerCount = 1;
+            blit.srcOffsets[1].x = static_cast<int32_t>(desc.levelWidth(image.baseLevel + level - 1));
+            blit.srcOffsets[1].y = static_cast<int32_t>(desc.levelHeight(image.baseLevel + level - 1));
+            blit.srcOffsets[1].z = 1;
+            blit.dstSubresource = blit.srcSubresource;
+            blit.dstSubresource.mipLevel = level;
+            blit.dstOffsets[1].x = static_cast<int32_t>(desc.levelWidth(image.baseLevel + level));
+            blit.dstOffsets[1].y = static_cast<int32_t>(desc.levelHeight(image.baseLevel + level));
+            blit.dstOffsets[1].z = 1;
+            vkCmdBlitImage(graphicsCmd, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, mipFilter);
+        }
+
+        // Transition all levels for sampling: the ones used as blit sources are in the TRANSFER_SRC layout
+        const uint32_t firstSource = std::max(1u, uploadedLevels) - 1;
+        const uint32_t sourceCount = (uploadedLevels < image.levelCount) ? image.levelCount - uploadedLevels : 0;
+        if (firstSource > 0) {
+            imageBarrier(graphicsCmd, image.image, 0, firstSource,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        }
+        if (sourceCount > 0) {
+            imageBarrier(graphicsCmd, image.image, firstSource, sourceCount,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        }
+        imageBarrier(graphicsCmd, image.image, firstSource + sourceCount, image.levelCount - firstSource - sourceCount,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+
+    /// Record the data copied from the staging buffer to an image, and the generation of its missing levels
+    void captureUpload(const LoadResult& result, const GpuImage& image, const std::vector<VkBufferImageCopy>& regions) {
+        if (!capture || image.image == VK_NULL_HANDLE) {
+            return;
+        }
+        void* mapped = nullptr;
+        vkMapMemory(device, result.stagingMemory, 0, VK_WHOLE_SIZE, 0, &mapped);
+        for (const auto& region : regions) {
+            const size_t size = levelSize(region.imageExtent.width, region.imageExtent.height,
+                result.desc.texelSize, result.desc.compressed);
+            capture->uploadImage(image.image, region.imageSubresource.mipLevel,
+                static_cast<const unsigned char*>(mapped) + region.bufferOffset, size);
+        }
+        vkUnmapMemory(device, result.stagingMemory);
+        const uint32_t uploadedLevels = static_cast<uint32_t>(regions.size());
+        if (uploadedLevels < image.levelCount) {
+            capture->generateMips(image.image, uploadedLevels, image.levelCount - uploadedLevels);
+        }
+    }
+
+    /// Record and submit the copy of the resident levels of a texture, but the finest one, to a new smaller image
+    PendingOp submitStreamOut(const Texture& texture, uint32_t newBase) {
+        const GpuImage& source = texture.resident;
+        PendingOp op;
+        op.resident = createImage(texture.desc, newBase, texture.desc.levelCount - newBase);
+        op.replacesResident = true;
+        beginOp(op, false);
+
+        imageBarrier(op.graphicsCmd, source.image, 1, source.levelCount - 1,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        imageBarrier(op.graphicsCmd, op.resident.image, 0, op.resident.levelCount,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        std::vector<VkImageCopy> regions;
+        for (uint32_t level = 0; level < op.resident.levelCount; level++) {
+            VkImageCopy region = {};
+            region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.srcSubresource.mipLevel = level + 1;
+            region.srcSubresource.baseArrayLayer = 0;
+            region.srcSubresource.layerCount = 1;
+            region.dstSubresource = region.srcSubresource;
+            region.dstSubresource.mipLevel = level;
+            region.extent = { texture.desc.levelWidth(newBase + level), texture.desc.levelHeight(newBase + level), 1 };
+            regions.push_back(region);
+        }
+        vkCmdCopyImage(op.graphicsCmd, source.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            op.resident.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+        if (capture) {
+            capture->copyImage(source.image, op.resident.image, 1, 0, op.resident.levelCount);
+        }
+
+        // The source image stays usable by frames recorded before the new one is installed
+        imageBarrier(op.graphicsCmd, source.image, 1, source.levelCount - 1,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        imageBarrier(op.graphicsCmd, op.resident.image, 0, op.resident.levelCount,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        vkEndCommandBuffer(op.graphicsCmd);
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &op.graphicsCmd;
+        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, op.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit texture stream out!");
+        }
+        return op;
+    }
+
+    /// Allocate the command buffers, the fence and the semaphore of a transfer
+    void beginOp(PendingOp& op, bool withTransfer) {
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+        allocInfo.commandPool = graphicsPool;
+        vkAllocateCommandBuffers(device, &allocInfo, &op.graphicsCmd);
+        if (withTransfer) {
+            allocInfo.commandPool = transferPool;
+            vkAllocateCommandBuffers(device, &allocInfo, &op.transferCmd);
+
+            VkSemaphoreCreateInfo semaphoreInfo = {};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            vkCreateSemaphore(device, &semaphoreInfo, nullptr, &op.semaphore);
+        }
+
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(device, &fenceInfo, nullptr, &op.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture transfer fence!");
+        }
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(op.graphicsCmd, &beginInfo);
+        if (withTransfer) {
+            vkBeginCommandBuffer(op.transferCmd, &beginInfo);
+        }
+    }
+
+    /// Release the command buffers, the synchronization objects and the staging buffer of a completed transfer
+    void releaseOp(PendingOp& op) {
+        vkFreeCommandBuffers(device, graphicsPool, 1, &op.graphicsCmd);
+        if (op.transferCmd != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(device, transferPool, 1, &op.transferCmd);
+        }
+        if (op.semaphore != VK_NULL_HANDLE) {
+            vkDestroySemaphore(device, op.semaphore, nullptr);
+        }
+        vkDestroyFence(device, op.fence, nullptr);
+        destroyBuffer(device, op.staging, op.stagingMemory);
+    }
+
+    /// Create an image for a range of mip levels of a texture, with its memory and its view
+    GpuImage createImage(const TextureDesc& desc, uint32_t baseLevel, uint32_t levelCount) {
+        GpuImage image;
+        image.baseLevel = baseLevel;
+        image.levelCount = levelCount;
+
+        const uint32_t queueFamilyIndices[] = { graphicsFamily, transferFamily };
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = { desc.levelWidth(baseLevel), desc.levelHeight(baseLevel), 1 };
+        imageInfo.mipLevels = levelCount;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = desc.format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        // Shared by the transfer and graphics queues without ownership transfers
+        if (graphicsFamily != transferFamily) {
+            imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+            imageInfo.queueFamilyIndexCount = 2;
+            imageInfo.pQueueFamilyIndices = queueFamilyIndices;
+        } else {
+            imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        }
+        if (vkCreateImage(device, &imageInfo, nullptr, &image.image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture image!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, image.image, &memRequirements);
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &image.memory) != VK_SUCCESS) {
+            vkDestroyImage(device, image.image, nullptr);
+            throw std::runtime_error("failed to allocate texture image memory!");
+        }
+        vkBindImageMemory(device, image.image, image.memory, 0);
+        image.size = memRequirements.size;
+        usedBytes += image.size;
+        if (capture) {
+            capture->createImage(image.image, desc.format, imageInfo.extent.width, imageInfo.extent.height, levelCount, imageInfo.usage);
+        }
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = desc.format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = levelCount;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+        if (vkCreateImageView(device, &viewInfo, nullptr, &image.view) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture image view!");
+        }
+
+        return image;
+    }
+
+    /// Destroy an image with its view and memory
+    void destroyImage(GpuImage& image) {
+        if (image.view != VK_NULL_HANDLE) {
+            vkDestroyImageView(device, image.view, nullptr);
+        }
+        if (image.image != VK_NULL_HANDLE) {
+            if (capture) {
+                capture->destroyImage(image.image);
+            }
+            vkDestroyImage(device, image.image, nullptr);
+        }
+        if (image.memory != VK_NULL_HANDLE) {
+            vkFreeMemory(device, image.memory, nullptr);
+            usedBytes -= image.size;
+        }
+        image = GpuImage();
+    }
+
+    /// Defer the destruction of a replaced image
+    void retire(GpuImage& image) {
+        if (image.image != VK_NULL_HANDLE) {
+            RetiredImage retired;
+            retired.image = image;
+            retired.frame = frameCounter;
+            retiredImages.push_back(retired);
+            image = GpuImage();
+        }
+    }
+
+    /// Create a command pool for short lived command buffers
+    VkCommandPool createCommandPool(uint32_t queueFamily) {
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = queueFamily;
+
+        VkCommandPool commandPool;
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture command pool!");
+        }
+        return commandPool;
+    }
+
+    /// Record a layout transition of a range of mip levels of an image
+    static void imageBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseLevel, uint32_t levelCount,
+                             VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+                             VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+        if (levelCount == 0) {
+            return;
+        }
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = baseLevel;
+        barrier.subresourceRange.levelCount = levelCount;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+private:
+    ThreadPool                  loaderPool{LOADER_THREAD_COUNT, WORKER_PRIORITY_LOW}; ///< Low priority threads decoding the images
+    VkPhysicalDevice            physicalDevice          = VK_NULL_HANDLE;   ///< Physical Device (GPU)
+    VkDevice                    device                  = VK_NULL_HANDLE;   ///< Logical Device
+    uint32_t                    graphicsFamily          = 0;                ///< Queue family of the graphics queue
+    VkQueue                     graphicsQueue           = VK_NULL_HANDLE;   ///< Queue generating the mip levels
+    uint32_t                    transferFamily          = 0;                ///< Queue family of the transfer queue
+    VkQueue                     transferQueue           = VK_NULL_HANDLE;   ///< Queue copying the staging buffers
+    VkCommandPool               graphicsPool            = VK_NULL_HANDLE;   ///< Command buffers of the graphics queue
+    VkCommandPool               transferPool            = VK_NULL_HANDLE;   ///< Command buffers of the transfer queue
+    bool                        compressionSupported    = false;            ///< Block-compressed formats are supported
+    VkSampler                   sampler                 = VK_NULL_HANDLE;   ///< Trilinear sampler
+    GpuImage                    defaultImage;                               ///< 1x1 white image
+    VkDeviceSize                budget                  = 0;                ///< Memory budget of the images
+    VkDeviceSize                usedBytes               = 0;                ///< Memory used by the images
+    VkDeviceSize                reservedBytes           = 0;                ///< Memory reserved by the images being decoded
+    uint64_t                    frameCounter            = 0;                ///< Number of updates
+    std::vector<Texture>        textures;                                   ///< All textures
+    std::vector<PendingLoad>    loads;                                      ///< Images being decoded
+    std::vector<PendingOp>      ops;                                        ///< Transfers in flight
+    std::vector<RetiredImage>   retiredImages;                              ///< Images waiting for their destruction
+    VulkanCapture*              capture                 = nullptr;          ///< Optional capture of the images
+};
@@ -0,0 +1,122 @@
+/**
+ * @file    ThreadPool.h
+ * @ingroup VulkanTest
+ * @brief   Fixed size pool of worker threads executing queued jobs.
+ *
+ * Copyright (c) 2017 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+/// Scheduling priority of the worker threads of a pool
+enum WorkerPriority {
+    WORKER_PRIORITY_NORMAL,     ///< Same priority as the thread creating the pool
+    WORKER_PRIORITY_LOW         ///< Background jobs yielding the CPU to the other threads (on Linux, else normal priority)
+};
+
+/**
+ * Fixed size pool of worker threads executing queued jobs in FIFO order
+ */
+class ThreadPool {
+public:
+    /// Start the worker threads (defaults to one per hardware thread)
+    explicit ThreadPool(size_t threadCount = 0, WorkerPriority priority = WORKER_PRIORITY_NORMAL) {
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.emplace_back([this, priority] {
+                if (priority == WORKER_PRIORITY_LOW) {
+                    lowerPriority();
+                }
+                workerLoop();
+            });
+        }
+    }
+
+    /// Wait for all queued jobs to complete, then join the worker threads
+    ~ThreadPool() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Number of worker threads
+    size_t size() const {
+        return workers.size();
+    }
+
+    /// Queue a job, returning a future to wait for its result (or the exception it threw)
+    template<typename F>
+    std::future<typename std::result_of<F()>::type> enqueue(F&& job) {
+        typedef typename std::result_of<F()>::type ResultType;
+        auto task = std::make_shared<std::packaged_task<ResultType()>>(std::forward<F>(job));
+        std::future<ResultType> result = task->get_future();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobs.emplace([task] { (*task)(); });
+        }
+        condition.notify_one();
+        return result;
+    }
+
+private:
+    /// Lower the scheduling priority of the calling worker thread
+    static void lowerPriority() {
+#ifdef __linux__
+        // On Linux, the nice value is a per-thread attribute: 0 designates the calling thread
+        setpriority(PRIO_PROCESS, 0, LOW_PRIORITY_NICE);
+#endif
+    }
+
+    /// Pop and execute jobs until the pool is stopping and the queue is empty
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping && jobs.empty()) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop();
+            }
+            job();
+        }
+    }
+
+private:
+    /// Nice value of the low priority worker threads (from 0 for normal, to 19 for the lowest priority)
+    static const int LOW_PRIORITY_NICE = 10;
+
+    std::vector<std::thread>            workers;            ///< Worker threads
+    std::queue<std::function<void()>>   jobs;               ///< Pending jobs
+    std::mutex                          mutex;              ///< Protect the job queue and the stopping flag
+    std::condition_variable             condition;          ///< Signal new jobs or stopping to the workers
+    bool                                stopping = false;   ///< Set by the destructor to end the worker loops
+};
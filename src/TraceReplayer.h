@@ -0,0 +1,1007 @@
+/**
+ * @file    TraceReplayer.h
+ * @ingroup VulkanTest
+ * @brief   Headless replay of a binary trace recorded by VulkanCapture.
+ *
+ * Copyright (c) 2017 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include "HeadlessRenderContext.h"
+#include "VulkanCapture.h"
+#include "VulkanMemory.h"
+
+#include <vulkan/vulkan.h>
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+
+/**
+ * Replay of a trace on a headless render context, to measure the GPU and driver cost without the application CPU cost
+ *
+ * Re-executes the recorded resource creations, uploads and commands, either as fast as possible or at the original pacing,
+ * submitting and waiting for each frame to measure its duration. Images are kept in the GENERAL layout,
+ * so the recorded barriers only keep their stages and access masks, and the render passes (one per color format)
+ * neither change the layout of the images they draw into. Push constants and textures are bound through the layout
+ * of the last bound pipeline.
+ */
+class TraceReplayer {
+public:
+    /// Replay a trace, as fast as possible or at the original pacing, then print the frame statistics
+    void run(const std::string& filename, bool paced) {
+        const TraceFile trace(filename);
+        const TraceHeader& header = trace.header();
+        std::cout << "[replay] " << filename << ": " << header.recordCount << " records, " << header.frameCount
+            << " frames captured in " << header.duration / 1000000 << " ms\n";
+
+        instance = PhysicalDeviceInfo::createInstance("Trace Replay");
+        try {
+            context.init(PhysicalDeviceInfo::pick(instance));
+            replay(trace, paced);
+        } catch (...) {
+            cleanup();
+            throw;
+        }
+        cleanup();
+    }
+
+private:
+    /// Buffer created by the replay
+    struct ReplayBuffer {
+        VkBuffer        buffer      = VK_NULL_HANDLE;   ///< Buffer
+        VkDeviceMemory  memory      = VK_NULL_HANDLE;   ///< Memory of the buffer
+        VkDeviceSize    size        = 0;                ///< Size of the buffer
+        void*           mapped      = nullptr;          ///< Persistently mapped memory, if host visible
+    };
+
+    /// Image created by the replay
+    struct ReplayImage {
+        VkImage         image       = VK_NULL_HANDLE;   ///< Image, always in the GENERAL layout
+        VkDeviceMemory  memory      = VK_NULL_HANDLE;   ///< Memory of the image
+        uint32_t        width       = 0;                ///< Width of the first level
+        uint32_t        height      = 0;                ///< Height of the first level
+        uint32_t        mipLevels   = 0;                ///< Number of levels
+        VkFormat        format      = VK_FORMAT_UNDEFINED; ///< Format of the texels
+        VkImageView     view        = VK_NULL_HANDLE;   ///< View of the first level, created by its first render pass
+        VkFramebuffer   framebuffer = VK_NULL_HANDLE;   ///< Framebuffer of the view, created by its first render pass
+        VkImageView     sampledView = VK_NULL_HANDLE;   ///< View of all the levels, created by its first texture bind
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE; ///< Descriptor set of the sampled view, created by its first texture bind
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE; ///< Pool of the descriptor set
+
+        /// Extent of a mip level
+        VkExtent3D extent(uint32_t level) const {
+            const VkExtent3D levelExtent = { std::max(1u, width >> level), std::max(1u, height >> level), 1 };
+            return levelExtent;
+        }
+    };
+
+    /// Pipeline created by the replay
+    struct ReplayPipeline {
+        VkPipeline          pipeline    = VK_NULL_HANDLE;   ///< Graphics pipeline
+        VkPipelineLayout    layout      = VK_NULL_HANDLE;   ///< Layout of the pipeline, destroyed with it
+        bool                materialSet = false;            ///< The layout has the descriptor set of a material
+    };
+
+    /// Push constants recorded before the first pipeline bind of the submission, pushed through the layout of that pipeline
+    struct PendingPush {
+        VkShaderStageFlags  stages      = 0;                ///< Shader stages
+        uint32_t            offset      = 0;                ///< Offset in the push constant block
+        std::vector<char>   data;                           ///< Data of the constants
+    };
+
+    /// Maximum number of descriptor sets of each pool allocated by the texture binds
+    static const uint32_t DESCRIPTOR_POOL_SIZE = 64;
+
+    /// Execute all the records, then print the frame statistics
+    void replay(const TraceFile& trace, bool paced) {
+        const auto start = std::chrono::steady_clock::now();
+        auto frameStart = start;
+        bool firstRecord = true;
+        uint64_t firstTime = 0;
+        uint64_t frameCount = 0;
+        double frameMsSum = 0.0;
+        double frameMsMin = 0.0;
+        double frameMsMax = 0.0;
+
+        size_t offset = trace.begin();
+        while (const TraceRecord* record = trace.next(offset)) {
+            if (firstRecord) {
+                firstRecord = false;
+                firstTime = record->time;
+            }
+            // Wait for the time of the record relative to the first one (never wait when late)
+            if (paced) {
+                std::this_thread::sleep_until(start + std::chrono::nanoseconds(record->time - firstTime));
+            }
+
+            switch (record->type) {
+            case TRACE_CREATE_BUFFER:
+                createBuffer(TraceFile::payload<TraceCreateBuffer>(record));
+                break;
+            case TRACE_DESTROY_BUFFER:
+                destroyBuffer(TraceFile::payload<TraceDestroy>(record).object);
+                break;
+            case TRACE_CREATE_IMAGE:
+                createImage(TraceFile::payload<TraceCreateImage>(record));
+                break;
+            case TRACE_DESTROY_IMAGE:
+                destroyImage(TraceFile::payload<TraceDestroy>(record).object);
+                break;
+            case TRACE_UPLOAD_BUFFER: {
+                const TraceUploadBuffer& upload = TraceFile::payload<TraceUploadBuffer>(record);
+                uploadBuffer(upload, TraceFile::payloadData<TraceUploadBuffer>(record, upload.size));
+                break;
+            }
+            case TRACE_UPLOAD_IMAGE: {
+                const TraceUploadImage& upload = TraceFile::payload<TraceUploadImage>(record);
+                uploadImage(upload, TraceFile::payloadData<TraceUploadImage>(record, upload.size));
+                break;
+            }
+            case TRACE_GENERATE_MIPS:
+                generateMips(TraceFile::payload<TraceGenerateMips>(record));
+                break;
+            case TRACE_COPY_IMAGE:
+                copyImage(TraceFile::payload<TraceCopyImage>(record));
+                break;
+            case TRACE_BEGIN_FRAME:
+                frameStart = std::chrono::steady_clock::now();
+                break;
+            case TRACE_IMAGE_BARRIER: {
+                const TraceImageBarrier& barrier = TraceFile::payload<TraceImageBarrier>(record);
+                imageBarrier(findImage(barrier.image).image, barrier.baseLevel, barrier.levelCount,
+                    barrier.srcStage, barrier.dstStage, barrier.srcAccess, barrier.dstAccess);
+                break;
+            }
+            case TRACE_CLEAR_COLOR_IMAGE:
+                clearColorImage(TraceFile::payload<TraceClearColorImage>(record));
+                break;
+            case TRACE_COPY_IMAGE_TO_BUFFER:
+                copyImageToBuffer(TraceFile::payload<TraceCopyImageToBuffer>(record));
+                break;
+            case TRACE_CREATE_PIPELINE: {
+                const TraceCreatePipeline& create = TraceFile::payload<TraceCreatePipeline>(record);
+                const uint64_t dataSize = create.bindingCount * sizeof(VkVertexInputBindingDescription) +
+                    create.attributeCount * sizeof(VkVertexInputAttributeDescription) +
+                    static_cast<uint64_t>(create.vertexCodeSize) + create.fragmentCodeSize;
+                createPipeline(create, TraceFile::payloadData<TraceCreatePipeline>(record, dataSize));
+                break;
+            }
+            case TRACE_DESTROY_PIPELINE:
+                destroyPipeline(TraceFile::payload<TraceDestroy>(record).object);
+                break;
+            case TRACE_BEGIN_RENDER_PASS:
+                beginRenderPass(TraceFile::payload<TraceBeginRenderPass>(record));
+                break;
+            case TRACE_END_RENDER_PASS:
+                vkCmdEndRenderPass(renderCommands());
+                renderPassImage = 0;
+                break;
+            case TRACE_BIND_PIPELINE:
+                bindPipeline(TraceFile::payload<TraceBindPipeline>(record).pipeline);
+                break;
+            case TRACE_PUSH_CONSTANTS: {
+                const TracePushConstants& push = TraceFile::payload<TracePushConstants>(record);
+                pushConstants(push, TraceFile::payloadData<TracePushConstants>(record, push.size));
+                break;
+            }
+            case TRACE_BIND_VERTEX_BUFFER: {
+                const TraceBindVertexBuffer& bind = TraceFile::payload<TraceBindVertexBuffer>(record);
+                const VkDeviceSize offset = bind.offset;
+                vkCmdBindVertexBuffers(renderCommands(), bind.binding, 1, &findBuffer(bind.buffer).buffer, &offset);
+                break;
+            }
+            case TRACE_BIND_INDEX_BUFFER: {
+                const TraceBindIndexBuffer& bind = TraceFile::payload<TraceBindIndexBuffer>(record);
+                vkCmdBindIndexBuffer(renderCommands(), findBuffer(bind.buffer).buffer, bind.offset,
+                    static_cast<VkIndexType>(bind.indexType));
+                break;
+            }
+            case TRACE_DRAW_INDEXED: {
+                const TraceDrawIndexed& draw = TraceFile::payload<TraceDrawIndexed>(record);
+                vkCmdDrawIndexed(renderCommands(), draw.indexCount, draw.instanceCount, draw.firstIndex, draw.vertexOffset,
+                    draw.firstInstance);
+                break;
+            }
+            case TRACE_DRAW_INDEXED_INDIRECT: {
+                const TraceDrawIndexedIndirect& draw = TraceFile::payload<TraceDrawIndexedIndirect>(record);
+                vkCmdDrawIndexedIndirect(renderCommands(), findBuffer(draw.buffer).buffer, draw.offset, draw.drawCount, draw.stride);
+                break;
+            }
+            case TRACE_BIND_TEXTURE:
+                bindTexture(TraceFile::payload<TraceBindTexture>(record).image);
+                break;
+            case TRACE_END_FRAME: {
+                flush();
+                const double frameMs =
+                    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+                frameMsMin = (frameCount == 0) ? frameMs : std::min(frameMsMin, frameMs);
+                frameMsMax = std::max(frameMsMax, frameMs);
+                frameMsSum += frameMs;
+                frameCount++;
+                break;
+            }
+            default:
+                throw std::runtime_error("unknown trace record type!");
+            }
+        }
+        flush();
+        const double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::ostringstream report;
+        report << std::fixed << std::setprecision(2) << "[replay] " << frameCount << " frames in " << totalMs << " ms";
+        if (frameCount > 0) {
+            report << " (" << (1000.0 * frameCount / totalMs) << " fps), frame time avg " << frameMsSum / frameCount
+                << " ms, min " << frameMsMin << " ms, max " << frameMsMax << " ms";
+        }
+        report << (paced ? " at the original pacing\n" : " as fast as possible\n");
+        std::cout << report.str();
+    }
+
+    /// Command buffer of the current submission, started if needed, to record commands outside of a render pass
+    VkCommandBuffer commands() {
+        if (renderPassImage != 0) {
+            throw std::runtime_error("trace records a transfer or a barrier inside a render pass!");
+        }
+        if (!recording) {
+            context.beginCommands();
+            recording = true;
+        }
+        return context.getCommandBuffer();
+    }
+
+    /// Command buffer of the current submission, to record commands inside the render pass in progress
+    VkCommandBuffer renderCommands() {
+        if (renderPassImage == 0) {
+            throw std::runtime_error("trace records a draw outside of a render pass!");
+        }
+        return context.getCommandBuffer();
+    }
+
+    /// Submit the recorded commands and wait for their completion, then release the staging buffers
+    void flush() {
+        if (renderPassImage != 0) {
+            throw std::runtime_error("trace ends a frame or destroys an object inside a render pass!");
+        }
+        if (recording) {
+            context.submitCommands();
+            recording = false;
+        }
+        // The next command buffer starts without any bound pipeline
+        boundLayout = VK_NULL_HANDLE;
+        boundMaterialSet = false;
+        pendingPushes.clear();
+        for (auto& staging : stagingBuffers) {
+            ::destroyBuffer(context.getDevice(), staging.buffer, staging.memory);
+        }
+        stagingBuffers.clear();
+    }
+
+    ReplayBuffer& findBuffer(uint32_t id) {
+        const auto found = buffers.find(id);
+        if (found == buffers.end()) {
+            throw std::runtime_error("trace references an unknown buffer!");
+        }
+        return found->second;
+    }
+
+    ReplayImage& findImage(uint32_t id) {
+        const auto found = images.find(id);
+        if (found == images.end()) {
+            throw std::runtime_error("trace references an unknown image!");
+        }
+        return found->second;
+    }
+
+    ReplayPipeline& findPipeline(uint32_t id) {
+        const auto found = pipelines.find(id);
+        if (found == pipelines.end()) {
+            throw std::runtime_error("trace references an unknown pipeline!");
+        }
+        return found->second;
+    }
+
+    /// Create a host visible buffer filled with data, destroyed after the next submission
+    VkBuffer createStagingBuffer(const void* data, VkDeviceSize size) {
+        ReplayBuffer staging;
+        ::createBuffer(context.getPhysicalDevice().memoryProperties, context.getDevice(), size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging.buffer, staging.memory);
+        void* mapped = nullptr;
+        vkMapMemory(context.getDevice(), staging.memory, 0, size, 0, &mapped);
+        memcpy(mapped, data, static_cast<size_t>(size));
+        vkUnmapMemory(context.getDevice(), staging.memory);
+        stagingBuffers.push_back(staging);
+        return staging.buffer;
+    }
+
+    /// Create a buffer, host visible (and persistently mapped) if it was captured so
+    void createBuffer(const TraceCreateBuffer& record) {
+        ReplayBuffer buffer;
+        buffer.size = record.size;
+        const bool hostVisible = (record.properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+        const VkMemoryPropertyFlags properties = hostVisible ?
+            (VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        ::createBuffer(context.getPhysicalDevice().memoryProperties, context.getDevice(), record.size,
+            record.usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, buffer.buffer, buffer.memory);
+        if (hostVisible) {
+            vkMapMemory(context.getDevice(), buffer.memory, 0, record.size, 0, &buffer.mapped);
+        }
+        buffers[record.buffer] = buffer;
+    }
+
+    /// Destroy a buffer once the commands using it are completed
+    void destroyBuffer(uint32_t id) {
+        flush();
+        ReplayBuffer& buffer = findBuffer(id);
+        if (buffer.mapped) {
+            vkUnmapMemory(context.getDevice(), buffer.memory);
+        }
+        ::destroyBuffer(context.getDevice(), buffer.buffer, buffer.memory);
+        buffers.erase(id);
+    }
+
+    /// Create a device local image, and transition it to the GENERAL layout
+    void createImage(const TraceCreateImage& record) {
+        const VkDevice device = context.getDevice();
+        ReplayImage image;
+        image.width = record.width;
+        image.height = record.height;
+        image.mipLevels = record.mipLevels;
+        image.format = static_cast<VkFormat>(record.format);
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = image.extent(0);
+        imageInfo.mipLevels = record.mipLevels;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = static_cast<VkFormat>(record.format);
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = record.usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (vkCreateImage(device, &imageInfo, nullptr, &image.image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create replay image (unsupported format?)");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, image.image, &memRequirements);
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(context.getPhysicalDevice().memoryProperties, memRequirements.memoryTypeBits,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (vkAllocateMemory(device, &allocInfo, nullptr, &image.memory) != VK_SUCCESS) {
+            vkDestroyImage(device, image.image, nullptr);
+            throw std::runtime_error("failed to allocate replay image memory!");
+        }
+        vkBindImageMemory(device, image.image, image.memory, 0);
+        images[record.image] = image;
+
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image.image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = record.mipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        vkCmdPipelineBarrier(commands(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    /// Destroy an image once the commands using it are completed
+    void destroyImage(uint32_t id) {
+        flush();
+        ReplayImage& image = findImage(id);
+        if (image.framebuffer != VK_NULL_HANDLE) {
+            vkDestroyFramebuffer(context.getDevice(), image.framebuffer, nullptr);
+            vkDestroyImageView(context.getDevice(), image.view, nullptr);
+        }
+        if (image.descriptorSet != VK_NULL_HANDLE) {
+            vkFreeDescriptorSets(context.getDevice(), image.descriptorPool, 1, &image.descriptorSet);
+        }
+        if (image.sampledView != VK_NULL_HANDLE) {
+            vkDestroyImageView(context.getDevice(), image.sampledView, nullptr);
+        }
+        vkDestroyImage(context.getDevice(), image.image, nullptr);
+        vkFreeMemory(context.getDevice(), image.memory, nullptr);
+        images.erase(id);
+    }
+
+    /// Write to a mapped buffer, or copy through a staging buffer
+    void uploadBuffer(const TraceUploadBuffer& record, const void* data) {
+        ReplayBuffer& buffer = findBuffer(record.buffer);
+        if (record.offset + record.size > buffer.size) {
+            throw std::runtime_error("trace upload out of buffer range!");
+        }
+        if (buffer.mapped) {
+            memcpy(static_cast<char*>(buffer.mapped) + record.offset, data, static_cast<size_t>(record.size));
+        } else {
+            VkBufferCopy region = {};
+            region.dstOffset = record.offset;
+            region.size = record.size;
+            vkCmdCopyBuffer(commands(), createStagingBuffer(data, record.size), buffer.buffer, 1, &region);
+        }
+    }
+
+    /// Copy a mip level from a staging buffer
+    void uploadImage(const TraceUploadImage& record, const void* data) {
+        const ReplayImage& image = findImage(record.image);
+        VkBufferImageCopy region = {};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = record.mipLevel;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = image.extent(record.mipLevel);
+        vkCmdCopyBufferToImage(commands(), createStagingBuffer(data, record.size), image.image, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+        imageBarrier(image.image, record.mipLevel, 1, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    }
+
+    /// Blit each level from the previous one (with a nearest filter if the format does not support linear filtering)
+    void generateMips(const TraceGenerateMips& record) {
+        const ReplayImage& image = findImage(record.image);
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(context.getPhysicalDevice().device, image.format, &formatProperties);
+        const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+        if ((formatProperties.optimalTilingFeatures & blitFeatures) != blitFeatures) {
+            throw std::runtime_error("the replay device cannot blit the format of the captured mip generation");
+        }
+        const VkFilter filter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ?
+            VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+        for (uint32_t level = record.firstLevel; level < record.firstLevel + record.levelCount; level++) {
+            const VkExtent3D src = image.extent(level - 1);
+            const VkExtent3D dst = image.extent(level);
+            VkImageBlit blit = {};
+            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blit.srcSubresource.mipLevel = level - 1;
+            blit.srcSubresource.baseArrayLayer = 0;
+            blit.srcSubresource.layerCount = 1;
+            blit.srcOffsets[1].x = static_cast<int32_t>(src.width);
+            blit.srcOffsets[1].y = static_cast<int32_t>(src.height);
+            blit.srcOffsets[1].z = 1;
+            blit.dstSubresource = blit.srcSubresource;
+            blit.dstSubresource.mipLevel = level;
+            blit.dstOffsets[1].x = static_cast<int32_t>(dst.width);
+            blit.dstOffsets[1].y = static_cast<int32_t>(dst.height);
+            blit.dstOffsets[1].z = 1;
+            vkCmdBlitImage(commands(), image.image, VK_IMAGE_LAYOUT_GENERAL, image.image, VK_IMAGE_LAYOUT_GENERAL,
+                1, &blit, filter);
+            imageBarrier(image.image, level, 1, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        }
+    }
+
+    /// Copy mip levels between images
+    void copyImage(const TraceCopyImage& record) {
+        const ReplayImage& src = findImage(record.srcImage);
+        const ReplayImage& dst = findImage(record.dstImage);
+        std::vector<VkImageCopy> regions;
+        for (uint32_t level = 0; level < record.levelCount; level++) {
+            VkImageCopy region = {};
+            region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.srcSubresource.mipLevel = record.srcLevel + level;
+            region.srcSubresource.baseArrayLayer = 0;
+            region.srcSubresource.layerCount = 1;
+            region.dstSubresource = region.srcSubresource;
+            region.dstSubresource.mipLevel = record.dstLevel + level;
+            region.extent = dst.extent(record.dstLevel + level);
+            regions.push_back(region);
+        }
+        vkCmdCopyImage(commands(), src.image, VK_IMAGE_LAYOUT_GENERAL, dst.image, VK_IMAGE_LAYOUT_GENERAL,
+            static_cast<uint32_t>(regions.size()), regions.data());
+        imageBarrier(dst.image, record.dstLevel, record.levelCount, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    }
+
+    /// Record a barrier on a range of mip levels of an image kept in the GENERAL layout
+    void imageBarrier(VkImage image, uint32_t baseLevel, uint32_t levelCount, VkPipelineStageFlags srcStage,
+                      VkPipelineStageFlags dstStage, VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = baseLevel;
+        barrier.subresourceRange.levelCount = levelCount;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        vkCmdPipelineBarrier(commands(), srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    /// Clear the first level of an image
+    void clearColorImage(const TraceClearColorImage& record) {
+        const ReplayImage& image = findImage(record.image);
+        VkClearColorValue color = {};
+        memcpy(color.float32, record.color, sizeof(record.color));
+        VkImageSubresourceRange range = {};
+        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        range.baseMipLevel = 0;
+        range.levelCount = 1;
+        range.baseArrayLayer = 0;
+        range.layerCount = 1;
+        vkCmdClearColorImage(commands(), image.image, VK_IMAGE_LAYOUT_GENERAL, &color, 1, &range);
+    }
+
+    /// Copy a mip level of an image to a buffer
+    void copyImageToBuffer(const TraceCopyImageToBuffer& record) {
+        const ReplayImage& image = findImage(record.image);
+        const ReplayBuffer& buffer = findBuffer(record.buffer);
+        VkBufferImageCopy region = {};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = record.mipLevel;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = image.extent(record.mipLevel);
+        vkCmdCopyImageToBuffer(commands(), image.image, VK_IMAGE_LAYOUT_GENERAL, buffer.buffer, 1, &region);
+    }
+
+    /// Render pass drawing into the first level of an image of the given format, kept in the GENERAL layout
+    VkRenderPass findRenderPass(VkFormat format) {
+        const auto found = renderPasses.find(format);
+        if (found != renderPasses.end()) {
+            return found->second;
+        }
+
+        VkAttachmentDescription colorAttachment = {};
+        colorAttachment.format = format;
+        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_GENERAL;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkAttachmentReference colorAttachmentRef = {};
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_GENERAL;
+
+        VkSubpassDescription subpass = {};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorAttachmentRef;
+
+        // Order the render pass after the previous commands on the image, and the following commands after it
+        VkSubpassDependency dependencies[2] = {};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+        VkRenderPassCreateInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &colorAttachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 2;
+        renderPassInfo.pDependencies = dependencies;
+
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        if (vkCreateRenderPass(context.getDevice(), &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create replay render pass!");
+        }
+        renderPasses[format] = renderPass;
+        return renderPass;
+    }
+
+    /// Layout of the descriptor set of a material, created by the first pipeline using it
+    VkDescriptorSetLayout findMaterialSetLayout() {
+        if (materialSetLayout == VK_NULL_HANDLE) {
+            materialSetLayout = createMaterialSetLayout(context.getDevice());
+        }
+        return materialSetLayout;
+    }
+
+    /// Pipeline layout with a push constant range starting at offset 0, and the descriptor set of a material if needed
+    VkPipelineLayout createPipelineLayout(VkShaderStageFlags stages, uint32_t size, bool materialSet) {
+        VkPushConstantRange pushConstantRange = {};
+        pushConstantRange.stageFlags = stages;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = size;
+
+        const VkDescriptorSetLayout setLayout = materialSet ? findMaterialSetLayout() : VK_NULL_HANDLE;
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = materialSet ? 1 : 0;
+        pipelineLayoutInfo.pSetLayouts = &setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = (size > 0) ? 1 : 0;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        if (vkCreatePipelineLayout(context.getDevice(), &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create replay pipeline layout!");
+        }
+        return layout;
+    }
+
+    /// Create a shader module from SPIR-V code of the trace (4 bytes aligned)
+    VkShaderModule createShaderModule(const char* code, uint32_t size) {
+        VkShaderModuleCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        createInfo.codeSize = size;
+        createInfo.pCode = reinterpret_cast<const uint32_t*>(code);
+
+        VkShaderModule shaderModule = VK_NULL_HANDLE;
+        if (vkCreateShaderModule(context.getDevice(), &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create replay shader module!");
+        }
+        return shaderModule;
+    }
+
+    /// Create a graphics pipeline with the captured shaders, vertex input and rasterization state
+    void createPipeline(const TraceCreatePipeline& record, const void* data) {
+        const VkDevice device = context.getDevice();
+        const char* bytes = static_cast<const char*>(data);
+        const VkVertexInputBindingDescription* bindings = reinterpret_cast<const VkVertexInputBindingDescription*>(bytes);
+        bytes += record.bindingCount * sizeof(VkVertexInputBindingDescription);
+        const VkVertexInputAttributeDescription* attributes = reinterpret_cast<const VkVertexInputAttributeDescription*>(bytes);
+        bytes += record.attributeCount * sizeof(VkVertexInputAttributeDescription);
+        const VkShaderModule vertShaderModule = createShaderModule(bytes, record.vertexCodeSize);
+        const VkShaderModule fragShaderModule = createShaderModule(bytes + record.vertexCodeSize, record.fragmentCodeSize);
+
+        VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+        shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        shaderStages[0].module = vertShaderModule;
+        shaderStages[0].pName = "main";
+        shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        shaderStages[1].module = fragShaderModule;
+        shaderStages[1].pName = "main";
+
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInputInfo.vertexBindingDescriptionCount = record.bindingCount;
+        vertexInputInfo.pVertexBindingDescriptions = bindings;
+        vertexInputInfo.vertexAttributeDescriptionCount = record.attributeCount;
+        vertexInputInfo.pVertexAttributeDescriptions = attributes;
+
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = static_cast<VkPrimitiveTopology>(record.topology);
+        inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+        VkPipelineViewportStateCreateInfo viewportState = {};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = 1;
+        viewportState.scissorCount = 1;
+
+        const VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+        VkPipelineDynamicStateCreateInfo dynamicState = {};
+        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount = 2;
+        dynamicState.pDynamicStates = dynamicStates;
+
+        VkPipelineRasterizationStateCreateInfo rasterizer = {};
+        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizer.lineWidth = 1.0f;
+        rasterizer.cullMode = record.cullMode;
+        rasterizer.frontFace = static_cast<VkFrontFace>(record.frontFace);
+
+        VkPipelineMultisampleStateCreateInfo multisampling = {};
+        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        multisampling.minSampleShading = 1.0f;
+
+        VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+        colorBlendAttachment.colorWriteMask =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        colorBlendAttachment.blendEnable = VK_FALSE;
+
+        VkPipelineColorBlendStateCreateInfo colorBlending = {};
+        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlending.logicOpEnable = VK_FALSE;
+        colorBlending.attachmentCount = 1;
+        colorBlending.pAttachments = &colorBlendAttachment;
+
+        ReplayPipeline pipeline;
+        pipeline.materialSet = (record.materialSet != 0);
+        pipeline.layout = createPipelineLayout(record.pushConstantStages, record.pushConstantSize, pipeline.materialSet);
+
+        VkGraphicsPipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = 2;
+        pipelineInfo.pStages = shaderStages;
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = pipeline.layout;
+        pipelineInfo.renderPass = findRenderPass(static_cast<VkFormat>(record.colorFormat));
+        pipelineInfo.subpass = 0;
+
+        const VkResult result = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline.pipeline);
+        vkDestroyShaderModule(device, fragShaderModule, nullptr);
+        vkDestroyShaderModule(device, vertShaderModule, nullptr);
+        if (result != VK_SUCCESS) {
+            vkDestroyPipelineLayout(device, pipeline.layout, nullptr);
+            throw std::runtime_error("failed to create replay graphics pipeline!");
+        }
+        pipelines[record.pipeline] = pipeline;
+    }
+
+    /// Destroy a pipeline and its layout once the commands using them are completed
+    void destroyPipeline(uint32_t id) {
+        flush();
+        const ReplayPipeline& pipeline = findPipeline(id);
+        vkDestroyPipeline(context.getDevice(), pipeline.pipeline, nullptr);
+        vkDestroyPipelineLayout(context.getDevice(), pipeline.layout, nullptr);
+        pipelines.erase(id);
+    }
+
+    /// Bind a pipeline, then push through its layout the constants recorded before the first bind of the submission
+    void bindPipeline(uint32_t id) {
+        const ReplayPipeline& pipeline = findPipeline(id);
+        vkCmdBindPipeline(renderCommands(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.pipeline);
+        boundLayout = pipeline.layout;
+        boundMaterialSet = pipeline.materialSet;
+        for (const PendingPush& push : pendingPushes) {
+            vkCmdPushConstants(renderCommands(), boundLayout, push.stages, push.offset, static_cast<uint32_t>(push.data.size()),
+                push.data.data());
+        }
+        pendingPushes.clear();
+    }
+
+    /// Begin a render pass clearing the first level of an image, with a viewport and a scissor covering it
+    void beginRenderPass(const TraceBeginRenderPass& record) {
+        const VkCommandBuffer commandBuffer = commands();
+        ReplayImage& image = findImage(record.image);
+        const VkRenderPass renderPass = findRenderPass(image.format);
+        if (image.framebuffer == VK_NULL_HANDLE) {
+            VkImageViewCreateInfo viewInfo = {};
+            viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            viewInfo.image = image.image;
+            viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            viewInfo.format = image.format;
+            viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            viewInfo.subresourceRange.baseMipLevel = 0;
+            viewInfo.subresourceRange.levelCount = 1;
+            viewInfo.subresourceRange.baseArrayLayer = 0;
+            viewInfo.subresourceRange.layerCount = 1;
+            if (vkCreateImageView(context.getDevice(), &viewInfo, nullptr, &image.view) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create replay image view!");
+            }
+
+            VkFramebufferCreateInfo framebufferInfo = {};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = renderPass;
+            framebufferInfo.attachmentCount = 1;
+            framebufferInfo.pAttachments = &image.view;
+            framebufferInfo.width = image.width;
+            framebufferInfo.height = image.height;
+            framebufferInfo.layers = 1;
+            if (vkCreateFramebuffer(context.getDevice(), &framebufferInfo, nullptr, &image.framebuffer) != VK_SUCCESS) {
+                vkDestroyImageView(context.getDevice(), image.view, nullptr);
+                image.view = VK_NULL_HANDLE;
+                throw std::runtime_error("failed to create replay framebuffer!");
+            }
+        }
+
+        VkClearValue clearColor = {};
+        memcpy(clearColor.color.float32, record.color, sizeof(record.color));
+
+        VkRenderPassBeginInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = image.framebuffer;
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent.width = image.width;
+        renderPassInfo.renderArea.extent.height = image.height;
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearColor;
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        renderPassImage = record.image;
+
+        VkViewport viewport = {};
+        viewport.width = static_cast<float>(image.width);
+        viewport.height = static_cast<float>(image.height);
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &renderPassInfo.renderArea);
+    }
+
+    /// Update push constants through the layout of the bound pipeline, or keep them until the first pipeline is bound
+    void pushConstants(const TracePushConstants& record, const void* data) {
+        if (boundLayout != VK_NULL_HANDLE) {
+            vkCmdPushConstants(renderCommands(), boundLayout, record.stages, record.offset, record.size, data);
+            return;
+        }
+        renderCommands();   // Check that a render pass is in progress
+        PendingPush push;
+        push.stages = record.stages;
+        push.offset = record.offset;
+        push.data.assign(static_cast<const char*>(data), static_cast<const char*>(data) + record.size);
+        pendingPushes.push_back(push);
+    }
+
+    /// Sampler of the textures, created by the first texture bind
+    VkSampler findSampler() {
+        if (sampler == VK_NULL_HANDLE) {
+            VkSamplerCreateInfo samplerInfo = {};
+            samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+            samplerInfo.magFilter = VK_FILTER_LINEAR;
+            samplerInfo.minFilter = VK_FILTER_LINEAR;
+            samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+            samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+            samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+            samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+            samplerInfo.maxAnisotropy = 1.0f;
+            samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+            samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+            if (vkCreateSampler(context.getDevice(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create replay sampler!");
+            }
+        }
+        return sampler;
+    }
+
+    /// Allocate a descriptor set of a material from the first pool with room left, adding a pool when all are full
+    VkDescriptorSet allocateMaterialSet(VkDescriptorPool& pool) {
+        const VkDescriptorSetLayout setLayout = findMaterialSetLayout();
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &setLayout;
+
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        for (const VkDescriptorPool descriptorPool : descriptorPools) {
+            allocInfo.descriptorPool = descriptorPool;
+            if (vkAllocateDescriptorSets(context.getDevice(), &allocInfo, &descriptorSet) == VK_SUCCESS) {
+                pool = descriptorPool;
+                return descriptorSet;
+            }
+        }
+
+        VkDescriptorPoolSize poolSize = {};
+        poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSize.descriptorCount = DESCRIPTOR_POOL_SIZE;
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = DESCRIPTOR_POOL_SIZE;
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        if (vkCreateDescriptorPool(context.getDevice(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create replay descriptor pool!");
+        }
+        descriptorPools.push_back(descriptorPool);
+
+        allocInfo.descriptorPool = descriptorPool;
+        if (vkAllocateDescriptorSets(context.getDevice(), &allocInfo, &descriptorSet) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate replay descriptor set!");
+        }
+        pool = descriptorPool;
+        return descriptorSet;
+    }
+
+    /// Bind all the levels of an image as the texture of the bound pipeline, creating its view and descriptor set the first time
+    void bindTexture(uint32_t id) {
+        const VkCommandBuffer commandBuffer = renderCommands();
+        if (!boundMaterialSet) {
+            throw std::runtime_error("trace binds a texture without a pipeline using it!");
+        }
+        ReplayImage& image = findImage(id);
+        if (image.descriptorSet == VK_NULL_HANDLE) {
+            if (image.sampledView == VK_NULL_HANDLE) {
+                VkImageViewCreateInfo viewInfo = {};
+                viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                viewInfo.image = image.image;
+                viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                viewInfo.format = image.format;
+                viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                viewInfo.subresourceRange.baseMipLevel = 0;
+                viewInfo.subresourceRange.levelCount = image.mipLevels;
+                viewInfo.subresourceRange.baseArrayLayer = 0;
+                viewInfo.subresourceRange.layerCount = 1;
+                if (vkCreateImageView(context.getDevice(), &viewInfo, nullptr, &image.sampledView) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create replay image view!");
+                }
+            }
+            image.descriptorSet = allocateMaterialSet(image.descriptorPool);
+            writeMaterialDescriptor(context.getDevice(), image.descriptorSet, image.sampledView, findSampler(), VK_IMAGE_LAYOUT_GENERAL);
+        }
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundLayout, 0, 1, &image.descriptorSet, 0, nullptr);
+    }
+
+    /// Destroy the remaining objects, the context and the instance
+    void cleanup() {
+        if (context.getDevice() != VK_NULL_HANDLE) {
+            if (recording) {
+                vkEndCommandBuffer(context.getCommandBuffer());
+                recording = false;
+            }
+            renderPassImage = 0;
+            vkDeviceWaitIdle(context.getDevice());
+            flush();
+            while (!buffers.empty()) {
+                destroyBuffer(buffers.begin()->first);
+            }
+            while (!images.empty()) {
+                destroyImage(images.begin()->first);
+            }
+            while (!pipelines.empty()) {
+                destroyPipeline(pipelines.begin()->first);
+            }
+            for (const VkDescriptorPool descriptorPool : descriptorPools) {
+                vkDestroyDescriptorPool(context.getDevice(), descriptorPool, nullptr);
+            }
+            descriptorPools.clear();
+            if (sampler != VK_NULL_HANDLE) {
+                vkDestroySampler(context.getDevice(), sampler, nullptr);
+                sampler = VK_NULL_HANDLE;
+            }
+            if (materialSetLayout != VK_NULL_HANDLE) {
+                vkDestroyDescriptorSetLayout(context.getDevice(), materialSetLayout, nullptr);
+                materialSetLayout = VK_NULL_HANDLE;
+            }
+            for (const auto& renderPass : renderPasses) {
+                vkDestroyRenderPass(context.getDevice(), renderPass.second, nullptr);
+            }
+            renderPasses.clear();
+        }
+        context.cleanup();
+        if (instance != VK_NULL_HANDLE) {
+            vkDestroyInstance(instance, nullptr);
+            instance = VK_NULL_HANDLE;
+        }
+    }
+
+private:
+    VkInstance                      instance    = VK_NULL_HANDLE;   ///< Vulkan instance
+    HeadlessRenderContext           context;                        ///< Logical Device, queue and command buffer
+    bool                            recording   = false;            ///< Commands are being recorded
+    uint32_t                        renderPassImage = 0;            ///< Trace id of the image of the render pass in progress
+    std::map<uint32_t, ReplayBuffer> buffers;                       ///< Buffers by trace id
+    std::map<uint32_t, ReplayImage> images;                         ///< Images by trace id
+    std::map<uint32_t, ReplayPipeline> pipelines;                   ///< Pipelines by trace id
+    VkPipelineLayout                boundLayout = VK_NULL_HANDLE;   ///< Layout of the pipeline bound in the current submission
+    bool                            boundMaterialSet = false;       ///< The bound pipeline has the descriptor set of a material
+    std::vector<PendingPush>        pendingPushes;                  ///< Push constants recorded before the first pipeline bind
+    VkDescriptorSetLayout           materialSetLayout = VK_NULL_HANDLE; ///< Layout of the descriptor set of a material
+    VkSampler                       sampler     = VK_NULL_HANDLE;   ///< Sampler of the textures
+    std::vector<VkDescriptorPool>   descriptorPools;                ///< Pools of the descriptor sets of the textures
+    std::map<VkFormat, VkRenderPass> renderPasses;                  ///< Render passes by color format
+    std::vector<ReplayBuffer>       stagingBuffers;                 ///< Staging buffers of the current submission
+};
@@ -0,0 +1,789 @@
+/**
+ * @file    VulkanCapture.h
+ * @ingroup VulkanTest
+ * @brief   Capture of resource creations, uploads and per-frame commands into a compact binary trace, and its memory-mapped reader.
+ *
+ * Copyright (c) 2017 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Binary trace format
+ *
+ * A TraceHeader followed by records, each one a TraceRecord followed by its payload structure and its data (if any),
+ * padded to TRACE_ALIGNMENT bytes so that a memory-mapped trace can be read in place.
+ * Vulkan objects are identified by sequential ids (starting at 1) assigned at creation.
+ */
+const uint32_t TRACE_MAGIC = 0x4B544B56;    ///< "VKTK" in little endian
+const uint32_t TRACE_VERSION = 1;           ///< Incremented on any change of the format
+const uint32_t TRACE_ALIGNMENT = 8;         ///< Alignment of the records
+
+/// Type of a trace record, defining the structure of its payload
+enum TraceRecordType {
+    TRACE_CREATE_BUFFER = 1,     ///< TraceCreateBuffer
+    TRACE_DESTROY_BUFFER,        ///< TraceDestroy
+    TRACE_CREATE_IMAGE,          ///< TraceCreateImage
+    TRACE_DESTROY_IMAGE,         ///< TraceDestroy
+    TRACE_UPLOAD_BUFFER,         ///< TraceUploadBuffer followed by the data
+    TRACE_UPLOAD_IMAGE,          ///< TraceUploadImage followed by the data of a mip level
+    TRACE_GENERATE_MIPS,         ///< TraceGenerateMips
+    TRACE_COPY_IMAGE,            ///< TraceCopyImage
+    TRACE_BEGIN_FRAME,           ///< TraceFrame
+    TRACE_IMAGE_BARRIER,         ///< TraceImageBarrier
+    TRACE_CLEAR_COLOR_IMAGE,     ///< TraceClearColorImage
+    TRACE_COPY_IMAGE_TO_BUFFER,  ///< TraceCopyImageToBuffer
+    TRACE_END_FRAME,             ///< TraceFrame
+    TRACE_CREATE_PIPELINE,       ///< TraceCreatePipeline followed by the vertex input descriptions and the SPIR-V shaders
+    TRACE_DESTROY_PIPELINE,      ///< TraceDestroy
+    TRACE_BEGIN_RENDER_PASS,     ///< TraceBeginRenderPass
+    TRACE_END_RENDER_PASS,       ///< TraceEndRenderPass
+    TRACE_BIND_PIPELINE,         ///< TraceBindPipeline
+    TRACE_PUSH_CONSTANTS,        ///< TracePushConstants followed by the data
+    TRACE_BIND_VERTEX_BUFFER,    ///< TraceBindVertexBuffer
+    TRACE_BIND_INDEX_BUFFER,     ///< TraceBindIndexBuffer
+    TRACE_DRAW_INDEXED,          ///< TraceDrawIndexed
+    TRACE_DRAW_INDEXED_INDIRECT, ///< TraceDrawIndexedIndirect
+    TRACE_BIND_TEXTURE           ///< TraceBindTexture
+};
+
+/// Header at the start of the trace
+struct TraceHeader {
+    uint32_t    magic;          ///< TRACE_MAGIC
+    uint32_t    version;        ///< TRACE_VERSION
+    uint64_t    recordCount;    ///< Number of records
+    uint64_t    frameCount;     ///< Number of frames
+    uint64_t    duration;       ///< Duration of the capture in nanoseconds
+};
+
+/// Header of each record
+struct TraceRecord {
+    uint32_t    type;           ///< TraceRecordType
+    uint32_t    size;           ///< Size of the record, including this header and the padding
+    uint64_t    time;           ///< Time since the start of the capture in nanoseconds
+};
+
+/// Buffer creation
+struct TraceCreateBuffer {
+    uint32_t    buffer;         ///< Id of the buffer
+    uint32_t    usage;          ///< VkBufferUsageFlags
+    uint64_t    size;           ///< Size in bytes
+    uint32_t    properties;     ///< VkMemoryPropertyFlags of its memory
+    uint32_t    padding;        ///< Unused
+};
+
+/// Image creation (2D, color)
+struct TraceCreateImage {
+    uint32_t    image;          ///< Id of the image
+    uint32_t    format;         ///< VkFormat
+    uint32_t    width;          ///< Width of the first level
+    uint32_t    height;         ///< Height of the first level
+    uint32_t    mipLevels;      ///< Number of levels
+    uint32_t    usage;          ///< VkImageUsageFlags
+};
+
+/// Buffer, image or pipeline destruction
+struct TraceDestroy {
+    uint32_t    object;         ///< Id of the buffer, image or pipeline
+    uint32_t    padding;        ///< Unused
+};
+
+/// Write of data to a buffer (host write to mapped memory)
+struct TraceUploadBuffer {
+    uint32_t    buffer;         ///< Id of the buffer
+    uint32_t    padding;        ///< Unused
+    uint64_t    offset;         ///< Offset in the buffer
+    uint64_t    size;           ///< Size of the data following the structure
+};
+
+/// Upload of a whole mip level of an image (through a staging buffer)
+struct TraceUploadImage {
+    uint32_t    image;          ///< Id of the image
+    uint32_t    mipLevel;       ///< Level of the image
+    uint64_t    size;           ///< Size of the data following the structure
+};
+
+/// Generation of mip levels, each one blitted from the previous one
+struct TraceGenerateMips {
+    uint32_t    image;          ///< Id of the image
+    uint32_t    firstLevel;     ///< First level to generate
+    uint32_t    levelCount;     ///< Number of levels to generate
+    uint32_t    padding;        ///< Unused
+};
+
+/// Copy of mip levels between images
+struct TraceCopyImage {
+    uint32_t    srcImage;       ///< Id of the source image
+    uint32_t    dstImage;       ///< Id of the destination image
+    uint32_t    srcLevel;       ///< First level of the source image
+    uint32_t    dstLevel;       ///< First level of the destination image
+    uint32_t    levelCount;     ///< Number of levels
+    uint32_t    padding;        ///< Unused
+};
+
+/// Frame boundary
+struct TraceFrame {
+    uint64_t    frame;          ///< Index of the frame
+};
+
+/// Pipeline barrier on a range of mip levels of an image
+struct TraceImageBarrier {
+    uint32_t    image;          ///< Id of the image
+    uint32_t    baseLevel;      ///< First level
+    uint32_t    levelCount;     ///< Number of levels
+    uint32_t    srcStage;       ///< VkPipelineStageFlags
+    uint32_t    dstStage;       ///< VkPipelineStageFlags
+    uint32_t    srcAccess;      ///< VkAccessFlags
+    uint32_t    dstAccess;      ///< VkAccessFlags
+    uint32_t    padding;        ///< Unused
+};
+
+/// Clear of the first level of an image
+struct TraceClearColorImage {
+    uint32_t    image;          ///< Id of the image
+    float       color[4];       ///< Clear color
+    uint32_t    padding;        ///< Unused
+};
+
+/// Copy of a mip level of an image to a buffer
+struct TraceCopyImageToBuffer {
+    uint32_t    image;          ///< Id of the image
+    uint32_t    buffer;         ///< Id of the buffer
+    uint32_t    mipLevel;       ///< Level of the image
+    uint32_t    padding;        ///< Unused
+};
+
+/**
+ * Graphics pipeline creation, drawing into a single color attachment without blending, with a dynamic viewport and scissor
+ *
+ * Followed by bindingCount VkVertexInputBindingDescription, attributeCount VkVertexInputAttributeDescription,
+ * then the SPIR-V code of the vertex shader and of the fragment shader (both with a "main" entry point).
+ */
+struct TraceCreatePipeline {
+    uint32_t    pipeline;           ///< Id of the pipeline
+    uint32_t    colorFormat;        ///< VkFormat of the color attachment
+    uint32_t    topology;           ///< VkPrimitiveTopology
+    uint32_t    cullMode;           ///< VkCullModeFlags
+    uint32_t    frontFace;          ///< VkFrontFace
+    uint32_t    pushConstantStages; ///< VkShaderStageFlags of the push constant range (none if its size is 0)
+    uint32_t    pushConstantSize;   ///< Size of the push constant range, starting at offset 0
+    uint32_t    bindingCount;       ///< Number of vertex input bindings
+    uint32_t    attributeCount;     ///< Number of vertex input attributes
+    uint32_t    vertexCodeSize;     ///< Size of the SPIR-V code of the vertex shader
+    uint32_t    fragmentCodeSize;   ///< Size of the SPIR-V code of the fragment shader
+    uint32_t    materialSet;        ///< 1 if the layout has the descriptor set of a material (texture sampled at binding 0 of set 0)
+};
+
+/// Start of a render pass into the first level of an image, cleared, with a viewport and a scissor covering the whole image
+struct TraceBeginRenderPass {
+    uint32_t    image;          ///< Id of the image
+    float       color[4];       ///< Clear color
+    uint32_t    padding;        ///< Unused
+};
+
+/// End of a render pass
+struct TraceEndRenderPass {
+    uint32_t    image;          ///< Id of the image
+    uint32_t    padding;        ///< Unused
+};
+
+/// Bind of a graphics pipeline
+struct TraceBindPipeline {
+    uint32_t    pipeline;       ///< Id of the pipeline
+    uint32_t    padding;        ///< Unused
+};
+
+/// Update of push constants, compatible with the layout of the captured pipelines
+struct TracePushConstants {
+    uint32_t    stages;         ///< VkShaderStageFlags
+    uint32_t    offset;         ///< Offset in the push constant range
+    uint32_t    size;           ///< Size of the data following the structure
+    uint32_t    padding;        ///< Unused
+};
+
+/// Bind of a vertex buffer
+struct TraceBindVertexBuffer {
+    uint32_t    binding;        ///< Vertex input binding
+    uint32_t    buffer;         ///< Id of the buffer
+    uint64_t    offset;         ///< Offset in the buffer
+};
+
+/// Bind of an index buffer
+struct TraceBindIndexBuffer {
+    uint32_t    buffer;         ///< Id of the buffer
+    uint32_t    indexType;      ///< VkIndexType
+    uint64_t    offset;         ///< Offset in the buffer
+};
+
+/// Direct indexed draw
+struct TraceDrawIndexed {
+    uint32_t    indexCount;     ///< Number of indices
+    uint32_t    instanceCount;  ///< Number of instances
+    uint32_t    firstIndex;     ///< First index
+    int32_t     vertexOffset;   ///< Value added to the indices
+    uint32_t    firstInstance;  ///< First instance
+    uint32_t    padding;        ///< Unused
+};
+
+/// Indirect indexed draws, reading VkDrawIndexedIndirectCommand from a buffer
+struct TraceDrawIndexedIndirect {
+    uint32_t    buffer;         ///< Id of the buffer
+    uint32_t    drawCount;      ///< Number of draws
+    uint64_t    offset;         ///< Offset of the first command in the buffer
+    uint32_t    stride;         ///< Stride between the commands
+    uint32_t    padding;        ///< Unused
+};
+
+/// Bind of the texture of a material (all the levels of an image) to the bound pipeline, at binding 0 of set 0
+struct TraceBindTexture {
+    uint32_t    image;          ///< Id of the image
+    uint32_t    padding;        ///< Unused
+};
+
+/**
+ * Capture of the Vulkan work of the application into a binary trace
+ *
+ * Called next to the Vulkan calls to record, with the same handles: the captured objects are mapped to sequential ids.
+ * Each call appends one record with its timestamp. Thread safe, but a trace only makes sense for a single Logical Device,
+ * and the records of a render pass must not be interleaved with transfers recorded by other threads.
+ * Operations on objects created before the capture started are skipped, as they could not be replayed.
+ */
+class VulkanCapture {
+public:
+    ~VulkanCapture() {
+        close();
+    }
+
+    /// Create the trace file and write its header
+    void open(const std::string& filename) {
+        std::lock_guard<std::mutex> lock(mutex);
+        file = std::fopen(filename.c_str(), "wb");
+        if (!file) {
+            throw std::runtime_error("failed to create trace file " + filename);
+        }
+        header = TraceHeader();
+        header.magic = TRACE_MAGIC;
+        header.version = TRACE_VERSION;
+        std::fwrite(&header, sizeof(header), 1, file);
+        start = std::chrono::steady_clock::now();
+        std::cout << "[capture] Recording trace " << filename << std::endl;
+    }
+
+    /// Complete the header of the trace and close it
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!file) {
+            return;
+        }
+        header.duration = now();
+        std::fseek(file, 0, SEEK_SET);
+        std::fwrite(&header, sizeof(header), 1, file);
+        std::fclose(file);
+        file = nullptr;
+        std::cout << "[capture] " << header.recordCount << " records, " << header.frameCount << " frames\n";
+    }
+
+    /// Record the creation of a buffer with its memory
+    void createBuffer(VkBuffer buffer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceCreateBuffer record = {};
+        record.buffer = assignId(buffer);
+        record.usage = usage;
+        record.size = size;
+        record.properties = properties;
+        write(TRACE_CREATE_BUFFER, record);
+    }
+
+    /// Record the destruction of a buffer (ignored if not captured)
+    void destroyBuffer(VkBuffer buffer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceDestroy record = {};
+        record.object = releaseId(buffer);
+        if (record.object) {
+            write(TRACE_DESTROY_BUFFER, record);
+        }
+    }
+
+    /// Record the creation of a 2D color image with its memory
+    void createImage(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, VkImageUsageFlags usage) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceCreateImage record = {};
+        record.image = assignId(image);
+        record.format = format;
+        record.width = width;
+        record.height = height;
+        record.mipLevels = mipLevels;
+        record.usage = usage;
+        write(TRACE_CREATE_IMAGE, record);
+    }
+
+    /// Record the destruction of an image (ignored if not captured)
+    void destroyImage(VkImage image) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceDestroy record = {};
+        record.object = releaseId(image);
+        if (record.object) {
+            write(TRACE_DESTROY_IMAGE, record);
+        }
+    }
+
+    /// Record a host write to the memory of a buffer, with a copy of the data
+    void uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceUploadBuffer record = {};
+        record.buffer = findId(buffer);
+        record.offset = offset;
+        record.size = size;
+        if (record.buffer) {
+            write(TRACE_UPLOAD_BUFFER, record, data, size);
+        }
+    }
+
+    /// Record the upload of a whole mip level of an image, with a copy of the data
+    void uploadImage(VkImage image, uint32_t mipLevel, const void* data, VkDeviceSize size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceUploadImage record = {};
+        record.image = findId(image);
+        record.mipLevel = mipLevel;
+        record.size = size;
+        if (record.image) {
+            write(TRACE_UPLOAD_IMAGE, record, data, size);
+        }
+    }
+
+    /// Record the generation of mip levels of an image, each one blitted from the previous one
+    void generateMips(VkImage image, uint32_t firstLevel, uint32_t levelCount) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceGenerateMips record = {};
+        record.image = findId(image);
+        record.firstLevel = firstLevel;
+        record.levelCount = levelCount;
+        if (record.image) {
+            write(TRACE_GENERATE_MIPS, record);
+        }
+    }
+
+    /// Record the copy of mip levels between images
+    void copyImage(VkImage srcImage, VkImage dstImage, uint32_t srcLevel, uint32_t dstLevel, uint32_t levelCount) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceCopyImage record = {};
+        record.srcImage = findId(srcImage);
+        record.dstImage = findId(dstImage);
+        record.srcLevel = srcLevel;
+        record.dstLevel = dstLevel;
+        record.levelCount = levelCount;
+        if (record.srcImage && record.dstImage) {
+            write(TRACE_COPY_IMAGE, record);
+        }
+    }
+
+    /// Record the start of a frame
+    void beginFrame(uint64_t frame) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceFrame record = {};
+        record.frame = frame;
+        write(TRACE_BEGIN_FRAME, record);
+    }
+
+    /// Record a pipeline barrier on a range of mip levels of an image
+    void imageBarrier(VkImage image, uint32_t baseLevel, uint32_t levelCount, VkPipelineStageFlags srcStage,
+                      VkPipelineStageFlags dstStage, VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceImageBarrier record = {};
+        record.image = findId(image);
+        record.baseLevel = baseLevel;
+        record.levelCount = levelCount;
+        record.srcStage = srcStage;
+        record.dstStage = dstStage;
+        record.srcAccess = srcAccess;
+        record.dstAccess = dstAccess;
+        if (record.image) {
+            write(TRACE_IMAGE_BARRIER, record);
+        }
+    }
+
+    /// Record the clear of the first level of an image
+    void clearColorImage(VkImage image, const VkClearColorValue& color) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceClearColorImage record = {};
+        record.image = findId(image);
+        memcpy(record.color, color.float32, sizeof(record.color));
+        if (record.image) {
+            write(TRACE_CLEAR_COLOR_IMAGE, record);
+        }
+    }
+
+    /// Record the copy of a mip level of an image to a buffer
+    void copyImageToBuffer(VkImage image, VkBuffer buffer, uint32_t mipLevel) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceCopyImageToBuffer record = {};
+        record.image = findId(image);
+        record.buffer = findId(buffer);
+        record.mipLevel = mipLevel;
+        if (record.image && record.buffer) {
+            write(TRACE_COPY_IMAGE_TO_BUFFER, record);
+        }
+    }
+
+    /// Record the end of a frame, submitted to the GPU
+    void endFrame(uint64_t frame) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceFrame record = {};
+        record.frame = frame;
+        write(TRACE_END_FRAME, record);
+        header.frameCount++;
+    }
+
+    /**
+     * Record the creation of a graphics pipeline, with the SPIR-V code of its shaders
+     *
+     * @param materialSet   The layout of the pipeline has the descriptor set of a material, bound with bindTexture()
+     */
+    void createPipeline(VkPipeline pipeline, VkFormat colorFormat, const VkGraphicsPipelineCreateInfo& pipelineInfo,
+                        const VkPushConstantRange& pushConstantRange, bool materialSet, const std::vector<char>& vertCode,
+                        const std::vector<char>& fragCode) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!file) {
+            return;
+        }
+        const VkPipelineVertexInputStateCreateInfo& vertexInput = *pipelineInfo.pVertexInputState;
+        TraceCreatePipeline record = {};
+        record.pipeline = assignId(pipeline);
+        record.colorFormat = colorFormat;
+        record.topology = pipelineInfo.pInputAssemblyState->topology;
+        record.cullMode = pipelineInfo.pRasterizationState->cullMode;
+        record.frontFace = pipelineInfo.pRasterizationState->frontFace;
+        record.pushConstantStages = pushConstantRange.stageFlags;
+        record.pushConstantSize = pushConstantRange.offset + pushConstantRange.size;
+        record.bindingCount = vertexInput.vertexBindingDescriptionCount;
+        record.attributeCount = vertexInput.vertexAttributeDescriptionCount;
+        record.vertexCodeSize = static_cast<uint32_t>(vertCode.size());
+        record.fragmentCodeSize = static_cast<uint32_t>(fragCode.size());
+        record.materialSet = materialSet ? 1 : 0;
+
+        // Concatenate the variable size data following the structure
+        std::vector<char> data;
+        const char* bindings = reinterpret_cast<const char*>(vertexInput.pVertexBindingDescriptions);
+        data.insert(data.end(), bindings, bindings + record.bindingCount * sizeof(VkVertexInputBindingDescription));
+        const char* attributes = reinterpret_cast<const char*>(vertexInput.pVertexAttributeDescriptions);
+        data.insert(data.end(), attributes, attributes + record.attributeCount * sizeof(VkVertexInputAttributeDescription));
+        data.insert(data.end(), vertCode.begin(), vertCode.end());
+        data.insert(data.end(), fragCode.begin(), fragCode.end());
+        write(TRACE_CREATE_PIPELINE, record, data.data(), data.size());
+    }
+
+    /// Record the destruction of a pipeline (ignored if not captured)
+    void destroyPipeline(VkPipeline pipeline) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceDestroy record = {};
+        record.object = releaseId(pipeline);
+        if (record.object) {
+            write(TRACE_DESTROY_PIPELINE, record);
+        }
+    }
+
+    /// Record the start of a render pass clearing the first level of an image, drawing with a viewport covering it
+    void beginRenderPass(VkImage image, const VkClearColorValue& color) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceBeginRenderPass record = {};
+        record.image = findId(image);
+        memcpy(record.color, color.float32, sizeof(record.color));
+        if (record.image) {
+            write(TRACE_BEGIN_RENDER_PASS, record);
+        }
+    }
+
+    /// Record the end of a render pass
+    void endRenderPass(VkImage image) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceEndRenderPass record = {};
+        record.image = findId(image);
+        if (record.image) {
+            write(TRACE_END_RENDER_PASS, record);
+        }
+    }
+
+    /// Record the bind of a graphics pipeline
+    void bindPipeline(VkPipeline pipeline) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceBindPipeline record = {};
+        record.pipeline = findId(pipeline);
+        if (record.pipeline) {
+            write(TRACE_BIND_PIPELINE, record);
+        }
+    }
+
+    /// Record an update of push constants, with a copy of the data
+    void pushConstants(VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TracePushConstants record = {};
+        record.stages = stages;
+        record.offset = offset;
+        record.size = size;
+        write(TRACE_PUSH_CONSTANTS, record, data, size);
+    }
+
+    /// Record the bind of a vertex buffer
+    void bindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceBindVertexBuffer record = {};
+        record.binding = binding;
+        record.buffer = findId(buffer);
+        record.offset = offset;
+        if (record.buffer) {
+            write(TRACE_BIND_VERTEX_BUFFER, record);
+        }
+    }
+
+    /// Record the bind of an index buffer
+    void bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceBindIndexBuffer record = {};
+        record.buffer = findId(buffer);
+        record.indexType = indexType;
+        record.offset = offset;
+        if (record.buffer) {
+            write(TRACE_BIND_INDEX_BUFFER, record);
+        }
+    }
+
+    /// Record a direct indexed draw
+    void drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceDrawIndexed record = {};
+        record.indexCount = indexCount;
+        record.instanceCount = instanceCount;
+        record.firstIndex = firstIndex;
+        record.vertexOffset = vertexOffset;
+        record.firstInstance = firstInstance;
+        write(TRACE_DRAW_INDEXED, record);
+    }
+
+    /// Record indirect indexed draws, whose commands are the ones uploaded to the buffer
+    void drawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount, uint32_t stride) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceDrawIndexedIndirect record = {};
+        record.buffer = findId(buffer);
+        record.drawCount = drawCount;
+        record.offset = offset;
+        record.stride = stride;
+        if (record.buffer) {
+            write(TRACE_DRAW_INDEXED_INDIRECT, record);
+        }
+    }
+
+    /// Record the bind of the texture of a material, an image sampled through a view of all its levels
+    void bindTexture(VkImage image) {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraceBindTexture record = {};
+        record.image = findId(image);
+        if (record.image) {
+            write(TRACE_BIND_TEXTURE, record);
+        }
+    }
+
+private:
+    /// Key of a Vulkan handle (a pointer or a 64 bits integer depending on the platform)
+    template<typename Handle>
+    static uint64_t handleKey(Handle handle) {
+        uint64_t key = 0;
+        memcpy(&key, &handle, sizeof(handle));
+        return key;
+    }
+
+    /// Assign the next id to a created handle
+    template<typename Handle>
+    uint32_t assignId(Handle handle) {
+        const uint32_t id = ++lastId;
+        ids[handleKey(handle)] = id;
+        return id;
+    }
+
+    /// Id of a captured handle (0 if not captured)
+    template<typename Handle>
+    uint32_t findId(Handle handle) const {
+        const auto found = ids.find(handleKey(handle));
+        return (found != ids.end()) ? found->second : 0;
+    }
+
+    /// Forget the id of a destroyed handle, returning it (0 if not captured)
+    template<typename Handle>
+    uint32_t releaseId(Handle handle) {
+        const uint32_t id = findId(handle);
+        ids.erase(handleKey(handle));
+        return id;
+    }
+
+    /// Nanoseconds since the start of the capture
+    uint64_t now() const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    /// Append a record with its payload and data (mutex locked)
+    template<typename Payload>
+    void write(TraceRecordType type, const Payload& payload, const void* data = nullptr, VkDeviceSize dataSize = 0) {
+        if (!file) {
+            return;
+        }
+        const size_t size = sizeof(TraceRecord) + sizeof(Payload) + static_cast<size_t>(dataSize);
+        const size_t paddedSize = (size + TRACE_ALIGNMENT - 1) & ~static_cast<size_t>(TRACE_ALIGNMENT - 1);
+        TraceRecord record;
+        record.type = type;
+        record.size = static_cast<uint32_t>(paddedSize);
+        record.time = now();
+        std::fwrite(&record, sizeof(record), 1, file);
+        std::fwrite(&payload, sizeof(payload), 1, file);
+        if (dataSize > 0) {
+            std::fwrite(data, static_cast<size_t>(dataSize), 1, file);
+        }
+        const char padding[TRACE_ALIGNMENT] = {};
+        std::fwrite(padding, paddedSize - size, 1, file);
+        header.recordCount++;
+    }
+
+private:
+    std::mutex                          mutex;                  ///< Serialize the records
+    std::FILE*                          file        = nullptr;  ///< Trace file being written
+    TraceHeader                         header      = {};       ///< Header, rewritten on close with the final counts
+    std::chrono::steady_clock::time_point start;                ///< Start of the capture
+    std::map<uint64_t, uint32_t>        ids;                    ///< Ids of the live captured handles
+    uint32_t                            lastId      = 0;        ///< Last assigned id
+};
+
+/**
+ * Read-only view of a trace file, memory-mapped on POSIX systems (read in memory on Windows)
+ */
+class TraceFile {
+public:
+    /// Map the trace and check its header
+    explicit TraceFile(const std::string& filename) {
+#ifdef _WIN32
+        std::ifstream stream(filename, std::ios::ate | std::ios::binary);
+        if (!stream.is_open()) {
+            throw std::runtime_error("failed to open trace file " + filename);
+        }
+        // 64 bits words to get the alignment required by the records
+        size = static_cast<size_t>(stream.tellg());
+        storage.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        stream.seekg(0);
+        stream.read(reinterpret_cast<char*>(storage.data()), size);
+        data = reinterpret_cast<const char*>(storage.data());
+#else
+        const int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("failed to open trace file " + filename);
+        }
+        struct stat status;
+        if (fstat(fd, &status) != 0 || status.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error("failed to read trace file " + filename);
+        }
+        size = static_cast<size_t>(status.st_size);
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("failed to map trace file " + filename);
+        }
+        data = static_cast<const char*>(mapping);
+#endif
+        if (size < sizeof(TraceHeader) || header().magic != TRACE_MAGIC) {
+            unmap();
+            throw std::runtime_error("invalid trace file " + filename);
+        }
+        if (header().version != TRACE_VERSION) {
+            unmap();
+            throw std::runtime_error("unsupported trace version in " + filename);
+        }
+    }
+
+    ~TraceFile() {
+        unmap();
+    }
+
+    TraceFile(const TraceFile&) = delete;
+    TraceFile& operator=(const TraceFile&) = delete;
+
+    /// Header of the trace
+    const TraceHeader& header() const {
+        return *reinterpret_cast<const TraceHeader*>(data);
+    }
+
+    /// Offset of the first record
+    size_t begin() const {
+        return sizeof(TraceHeader);
+    }
+
+    /// Record at an offset (nullptr at the end of the trace), advancing the offset to the next record
+    const TraceRecord* next(size_t& offset) const {
+        if (offset + sizeof(TraceRecord) > size) {
+            return nullptr;
+        }
+        const TraceRecord* record = reinterpret_cast<const TraceRecord*>(data + offset);
+        if (record->size < sizeof(TraceRecord) || record->size % TRACE_ALIGNMENT != 0 || offset + record->size > size) {
+            throw std::runtime_error("truncated or corrupted trace record");
+        }
+        offset += record->size;
+        return record;
+    }
+
+    /// Payload structure of a record, following its header
+    template<typename Payload>
+    static const Payload& payload(const TraceRecord* record) {
+        if (record->size < sizeof(TraceRecord) + sizeof(Payload)) {
+            throw std::runtime_error("trace record too small for its type");
+        }
+        return *reinterpret_cast<const Payload*>(record + 1);
+    }
+
+    /// Data following the payload structure of a record
+    template<typename Payload>
+    static const void* payloadData(const TraceRecord* record, uint64_t dataSize) {
+        if (record->size < sizeof(TraceRecord) + sizeof(Payload) + dataSize) {
+            throw std::runtime_error("trace record too small for its data");
+        }
+        return reinterpret_cast<const char*>(record + 1) + sizeof(Payload);
+    }
+
+private:
+    /// Release the content of the trace
+    void unmap() {
+#ifndef _WIN32
+        if (data) {
+            munmap(const_cast<char*>(data), size);
+        }
+#endif
+        data = nullptr;
+    }
+
+private:
+    const char*             data    = nullptr;  ///< Content of the trace
+    size_t                  size    = 0;        ///< Size of the trace
+#ifdef _WIN32
+    std::vector<uint64_t>   storage;            ///< Content of the trace read in memory
+#endif
+};
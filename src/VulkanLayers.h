@@ -0,0 +1,60 @@
+/**
+ * @file    VulkanLayers.h
+ * @ingroup VulkanTest
+ * @brief   Validation layers shared by the windowed application and the headless render contexts.
+ *
+ * Copyright (c) 2017 Sebastien Rombauts (sebastien.rombauts@gmail.com)
+ *
+ * Distributed under the MIT License (MIT) (See accompanying file LICENSE.txt
+ * or copy at http://opensource.org/licenses/MIT)
+ */
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <iostream>
+#include <vector>
+#include <cstring>
+
+/// Enable Validation Layers only on Debug build
+#ifdef NDEBUG
+const bool enableValidationLayers = false;
+#else
+const bool enableValidationLayers = true;
+#endif
+
+/// Names of validation layers that we would like to enable in Debug mode
+const std::vector<const char*> validationLayers = {
+    "VK_LAYER_LUNARG_standard_validation"
+};
+
+/// Check if our Vulkan SDK provides the validation layers we would like to use
+inline bool checkValidationLayerSupport() {
+    bool allLayersFound = true;
+    uint32_t layerCount;
+    vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+    std::vector<VkLayerProperties> availableLayers(layerCount);
+    vkEnumerateInstanceLayerProperties(&layerCount, availableLayers.data());
+    std::cout << "[init] There are " << layerCount << " available validation layers:\n";
+    for (const auto& layer : availableLayers) {
+        std::cout << "\t" << layer.layerName << std::endl;
+    }
+
+    for (const char* layerName : validationLayers) {
+        bool layerFound = false;
+
+        for (const auto& layer : availableLayers) {
+            if (strcmp(layerName, layer.layerName) == 0) {
+                layerFound = true;
+                break;
+            }
+        }
+
+        if (!layerFound) {
+            std::cerr << "[init] Missing validation layer " << layerName << std::endl;
+            allLayersFound = false;
+        }
+    }
+
+    return allLayersFound;
+}